@@ -0,0 +1,16 @@
+# Write a binary file as a C++ array, for compilers that can not .incbin it
+#   cmake -DINPUT=file.bin -DOUTPUT=file.cpp -DNAME=symbol -P bin2cpp.cmake
+
+file(READ "${INPUT}" hex HEX)
+
+# 16 bytes per line
+set(line "")
+foreach(i RANGE 15)
+  set(line "${line}[0-9a-f][0-9a-f]")
+endforeach()
+string(REGEX REPLACE "(${line})" "\\1\n" hex "${hex}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+
+file(WRITE "${OUTPUT}"
+  "// Generated from ${INPUT}, do not edit\n"
+  "extern const unsigned char ${NAME}[] = {\n${bytes}};\n")
@@ -1,8 +1,12 @@
 #include "autotidy.h"
+#include "check_registry.h"
+#include "doc_blob.h"
+#include "doc_search.h"
+#include "man_renderer.h"
+#include "notes.h"
 #include "replacer.h"
 #include "utils.h"
 
-#include <absl/strings/ascii.h>
 #include <absl/strings/match.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/str_split.h>
@@ -12,63 +16,269 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdio>
 #include <map>
+#include <numeric>
 #include <regex>
 #include <set>
+#include <tuple>
 #include <utility>
 
 using namespace std::string_literals;
 
-extern std::map<std::string, std::string> manPages;
-
 void AutoTidy::saveConfig()
 {
-    std::ofstream outf{".clang-tidy"};
+    std::ofstream outf{configFilename};
     for (auto const& line : confLines) {
         if (absl::StartsWith(line, "Checks:")) {
-            if (ignores.empty()) {
-                outf << "Checks: '*'\n";
-            } else {
-                outf << fmt::format("Checks: '*, -{}'\n",
-                                    absl::StrJoin(ignores, ", -"));
-            }
+            outf << fmt::format("Checks: '{}'\n",
+                                absl::StrJoin(checkFilter.patterns(), ", "));
         } else {
             outf << line << "\n";
         }
     }
 }
 
-void AutoTidy::printError(TidyError const& err)
+// Read a key from the terminal, or from the file being replayed. When the
+// replayed keys run out, the session is quit.
+char AutoTidy::readKey()
+{
+    char c = 'q';
+    if (replayFile.is_open()) {
+        if (replayFile.get(c)) {
+            replayedKeys++;
+        } else {
+            c = 'q';
+        }
+    } else {
+        c = getch();
+    }
+    keyTime = std::chrono::steady_clock::now();
+    keyPressed = true;
+    if (recordFile.is_open()) {
+        recordFile.put(c);
+        recordFile.flush();
+    }
+    return c;
+}
+
+void AutoTidy::recordKeys(utils::path const& fileName)
+{
+    recordFile.open(fileName.string(), std::ios::binary);
+}
+
+bool AutoTidy::replayKeys(utils::path const& fileName)
+{
+    replayFile.open(fileName.string(), std::ios::binary);
+    return replayFile.is_open();
+}
+
+void AutoTidy::flushScreen()
+{
+    {
+        ScopedTimer timer{timings[RenderPhase]};
+        std::fflush(stdout);
+        writeAll(1, screen.data(), screen.size());
+        screen.clear();
+    }
+    if (keyPressed) {
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - keyTime;
+        timings[ResponsePhase].add(ms.count());
+        keyPressed = false;
+    }
+}
+
+void AutoTidy::reportTimings()
+{
+    static std::array<char const*, PhaseCount> const names{
+        {"copy", "patch", "diff", "notes", "render", "response", "issue"}};
+
+    if (printTimings) {
+        show(fmt::fg(fmt::color::cyan), "{:<10}{:>10}{:>12}{:>12}{:>12}\n",
+             "phase", "count", "p50 ms", "p99 ms", "max ms");
+        for (size_t p = 0; p < PhaseCount; p++) {
+            auto const& h = timings[p];
+            show({}, "{:<10}{:>10}{:>12.3f}{:>12.3f}{:>12.3f}\n", names[p],
+                 h.count(), h.percentile(0.5), h.percentile(0.99), h.max());
+        }
+    }
+
+    if (!timingsFile.empty()) {
+        std::vector<std::string> phases;
+        for (size_t p = 0; p < PhaseCount; p++) {
+            auto const& h = timings[p];
+            std::vector<std::string> buckets;
+            h.forEachBucket([&](double limit, uint64_t count) {
+                buckets.push_back(fmt::format("[{:.6g}, {}]", limit, count));
+            });
+            phases.push_back(fmt::format(
+                "  \"{}\": {{\"count\": {}, \"p50\": {:.6g}, \"p99\": "
+                "{:.6g}, \"max\": {:.6g}, \"buckets\": [{}]}}",
+                names[p], h.count(), h.percentile(0.5), h.percentile(0.99),
+                h.max(), absl::StrJoin(buckets, ", ")));
+        }
+        writeFile(timingsFile,
+                  "{\n" + absl::StrJoin(phases, ",\n") + "\n}\n");
+    }
+}
+
+std::string AutoTidy::displayName(utils::path const& fileName) const
 {
-    std::string baseName = err.fileName;
+    std::string baseName = fileName;
     if (absl::StartsWith(baseName, currDir)) {
         baseName = baseName.substr(currDir.length());
     }
+    return baseName;
+}
+
+void AutoTidy::printError(TidyError const& err)
+{
+    show(fmt::fg(fmt::color::white), "\n#{} ", err.number);
+    show(fmt::fg(fmt::color::gold), "{}", displayName(err.fileName));
+    show(fmt::fg(fmt::color::white), ":{}", err.line);
+    show(fmt::fg(fmt::color::light_pink), " [{}]", err.check);
+    show(fmt::fg(fmt::color::light_green), "\n{}\n", err.error);
 
-    fmt::print(fmt::fg(fmt::color::white), "\n#{} ", err.number);
-    fmt::print(fmt::fg(fmt::color::gold), "{}", baseName);
-    fmt::print(fmt::fg(fmt::color::white), ":{}", err.line);
-    fmt::print(fmt::fg(fmt::color::light_pink), " [{}]", err.check);
-    fmt::print(fmt::fg(fmt::color::light_green), "\n{}\n", err.error);
-    std::puts(err.text.c_str());
+    size_t hidden = 0;
+    {
+        ScopedTimer timer{timings[NotesPhase]};
+        show(collapseNotes(readNotes(err), hidden) + "\n");
+    }
+    notesCollapsed = hidden > 0;
+}
+
+// The notes and source excerpt following an issue in the log
+std::string AutoTidy::readNotes(TidyError const& err) const
+{
+    std::string text(err.textLength, 0);
+    std::ifstream logFile(filename, std::ios::binary);
+    logFile.seekg(static_cast<std::streamoff>(err.textOffset));
+    logFile.read(&text[0], static_cast<std::streamsize>(text.size()));
+    text.resize(static_cast<size_t>(logFile.gcount()));
+    return text;
 }
 
 char AutoTidy::promptUser()
 {
-    bool hasPatch = !tempFiles.empty();
-    fmt::print(fmt::fg(fmt::color::cyan),
-               "{}[t]odo, [i]gnore, [s/S]kip, [n/N]olint, [d]oc, [q]uit, "
-               "[?] Help : ",
-               hasPatch ? "[a]pply, " : "");
-    std::fflush(stdout);
-    auto c = getch();
+    bool hasPatch = preview.hasPatch && !preview.conflicting;
+    if (preview.conflicting) {
+        show(fmt::fg(fmt::color::orange_red),
+             "Fix conflicts with an earlier change. ");
+    }
+    show(fmt::fg(fmt::color::cyan),
+         "{}[t]odo, [i]gnore, [s/S]kip, [n/N]olint, [d]oc, [l]ist, {}{}{}"
+         "[q]uit, [?] Help : ",
+         hasPatch ? "[a]pply, [A/I] apply similar, " : "",
+         notesCollapsed ? "[e]xpand notes, " : "",
+         replacer.canUndo() ? "[u]ndo, " : "",
+         replacer.canRedo() ? "[r]edo, " : "");
+    flushScreen();
+    auto c = readKey();
     if (c < 0x20 || c >= 0x7f) {
         c = ' ';
     }
-    fmt::print(fmt::bg(fmt::color::white) | fmt::fg(fmt::color::black), "[{}]",
-               static_cast<char>(c));
-    std::puts("");
+    show(fmt::bg(fmt::color::white) | fmt::fg(fmt::color::black), "[{}]",
+         static_cast<char>(c));
+    show("\n");
+    return c;
+}
+
+void AutoTidy::applyChange(TidyError const& err,
+                           std::vector<Replacement> const& replacements)
+{
+    if (!replacer.applyReplacements(replacements)) {
+        show(fmt::fg(fmt::color::orange_red),
+             "Change overlaps an earlier change, not applied\n");
+        return;
+    }
+    undoIssues.push_back({err.number});
+    redoIssues.clear();
+}
+
+// Apply the fixes of all remaining issues of the same check, or with
+// the same fix, in one step
+void AutoTidy::applySimilar(TidyError const& err, bool sameFix,
+                            bool wholeProject)
+{
+    // Files are only read here, so work on copies
+    std::map<std::string, PatchedFile> files;
+    auto signature = sameFix ? fixSignature(err, files) : "";
+
+    std::vector<int> issues{err.number};
+    for (size_t i = nextIssue; i < issueQueue.size(); i++) {
+        auto const& other = errorList[issueQueue[i]];
+        if (other.number == err.number || isIgnored(other) ||
+            other.replacements.empty() || other.check != err.check) {
+            continue;
+        }
+        if (!wholeProject &&
+            other.fileName.string() != err.fileName.string()) {
+            continue;
+        }
+        if (sameFix && fixSignature(other, files) != signature) {
+            continue;
+        }
+        issues.push_back(other.number);
+    }
+
+    std::vector<std::vector<Replacement>> fixes;
+    for (auto i : issues) {
+        fixes.push_back(errorList[i].replacements);
+    }
+    auto rejected = replacer.applyFixes(fixes);
+
+    std::vector<int> applied;
+    auto nextRejected = rejected.begin();
+    for (size_t i = 0; i < issues.size(); i++) {
+        if (nextRejected != rejected.end() && *nextRejected == i) {
+            ++nextRejected;
+            continue;
+        }
+        applied.push_back(issues[i]);
+        resolved.insert(issues[i]);
+    }
+    show({}, "Applied {} fixes", applied.size());
+    if (!rejected.empty()) {
+        show({}, ", {} overlapped an earlier change and were skipped",
+             rejected.size());
+    }
+    show("\n");
+
+    if (!applied.empty()) {
+        undoIssues.push_back(applied);
+        redoIssues.clear();
+    }
+}
+
+// The check and the replaced and replacing texts of an issue's fix
+std::string AutoTidy::fixSignature(TidyError const& err,
+                                   std::map<std::string, PatchedFile>& files)
+{
+    std::string signature = err.check;
+    for (auto const& r : err.replacements) {
+        auto it = files.find(r.path);
+        if (it == files.end()) {
+            it = files.emplace(r.path, replacer.snapshot(r.path)).first;
+        }
+        signature += '\0' + it->second.text(r.offset, r.length) + '\0' +
+                     r.text;
+    }
+    return signature;
+}
+
+// Ask if a bulk action should cover the current file or the project
+char AutoTidy::promptScope()
+{
+    show(fmt::fg(fmt::color::cyan),
+         "Apply to all remaining issues in this [f]ile, or in the whole "
+         "[p]roject? ");
+    flushScreen();
+    auto c = readKey();
+    show("\n");
     return c;
 }
 
@@ -79,29 +289,73 @@ bool AutoTidy::handleKey(char c, TidyError const& err)
         break;
     case '?':
     case 'h':
-        std::puts(helpText.c_str());
+        show(helpText + "\n");
         return false;
     case 'a':
-        for (auto const& f : tempFiles) {
-            // Copy temporary -> real
-            replacer.copyFile(std::get<RealName>(f), std::get<TempName>(f));
-            replacer.removeFile(std::get<TempName>(f));
+        // Patch the real files the same way as the preview
+        if (preview.hasPatch && !preview.conflicting) {
+            applyChange(err, err.replacements);
         }
-        tempFiles.clear();
         break;
+    case 'A':
+    case 'I': {
+        if (!preview.hasPatch || preview.conflicting) {
+            return false;
+        }
+        auto scope = promptScope();
+        if (scope != 'f' && scope != 'p') {
+            return false;
+        }
+        applySimilar(err, c == 'I', scope == 'p');
+        break;
+    }
     case 'n':
-        replacer.appendToLine(err.fileName, err.line, " //NOLINT");
+        applyChange(err, {replacer.appendReplacement(err.fileName, err.line,
+                                                     " //NOLINT")});
         break;
     case 'N':
-        replacer.appendToLine(err.fileName, err.line,
-                              fmt::format(" //NOLINT({})", err.check));
+        applyChange(err, {replacer.appendReplacement(
+                             err.fileName, err.line,
+                             fmt::format(" //NOLINT({})", err.check))});
         break;
     case 't':
-        replacer.appendToLine(err.fileName, err.line,
-                              fmt::format(" //TODO({})", err.check));
+        applyChange(err, {replacer.appendReplacement(
+                             err.fileName, err.line,
+                             fmt::format(" //TODO({})", err.check))});
+        break;
+    case 'u': {
+        if (undoIssues.empty() || !replacer.undo()) {
+            return false;
+        }
+        // Show the undone issues that we have passed, then the current one
+        std::set<int> ahead(issueQueue.begin() + nextIssue, issueQueue.end());
+        auto const& undone = undoIssues.back();
+        revisit.push_back(err.number);
+        for (auto it = undone.rbegin(); it != undone.rend(); ++it) {
+            resolved.erase(*it);
+            askAlways.insert(*it);
+            if (*it != err.number && !contains(ahead, *it)) {
+                revisit.push_back(*it);
+            }
+        }
+        redoIssues.push_back(undoIssues.back());
+        undoIssues.pop_back();
+        break;
+    }
+    case 'r':
+        if (redoIssues.empty() || !replacer.redo()) {
+            return false;
+        }
+        // The redone change resolves its issues again, like undo made
+        // them unresolved
+        resolved.insert(redoIssues.back().begin(), redoIssues.back().end());
+        revisit.push_back(err.number);
+        undoIssues.push_back(redoIssues.back());
+        redoIssues.pop_back();
         break;
     case 'i':
-        ignores.insert(err.check);
+        checkFilter.add("-" + err.check);
+        ignoredChecks.insert(err.checkId);
         saveConfig();
         break;
     case 's':
@@ -109,51 +363,453 @@ bool AutoTidy::handleKey(char c, TidyError const& err)
     case 'S':
         skippedFiles.insert(err.fileName);
         break;
-    case 'd':
-        pipeStringToCommand("man -l -", manPages[err.check]);
+    case 'l':
+        return listIssues(err);
+    case 'e':
+        show(readNotes(err) + "\n");
+        notesCollapsed = false;
         return false;
+    case 'd':
+        return showDoc(err);
+    case '/':
+        return findDocs(err);
     default:
         return false;
     }
     return true;
 }
 
-bool AutoTidy::handleError(const TidyError& err)
+bool AutoTidy::isIgnored(TidyError const& err) const
 {
-    static auto const separatorString = std::string(60, '-') + "\n";
+    return err.disabled || ignoredChecks.count(err.checkId) > 0 ||
+           err.fileName.empty() ||
+           skippedFiles.count(err.fileName) > 0 ||
+           resolved.count(err.number) > 0;
+}
+
+// The current versions of the files that the fixes of an issue change
+std::map<std::string, size_t>
+AutoTidy::previewVersions(TidyError const& err) const
+{
+    std::map<std::string, size_t> versions;
+    for (auto const& r : err.replacements) {
+        versions.emplace(r.path, replacer.version(r.path));
+    }
+    return versions;
+}
+
+PreviewJob AutoTidy::makePreviewJob(TidyError const& err) const
+{
+    PreviewJob job;
+    job.issue = err.number;
+    job.replacements = err.replacements;
+    job.versions = previewVersions(err);
+    for (auto const& v : job.versions) {
+        auto& pf = job.files[v.first];
+        pf = replacer.snapshot(v.first);
+        // Read here, so rendering never reads a file while it is written
+        (void)pf.contents();
+    }
+    return job;
+}
+
+// Start preparing the previews of the next issues that will be shown.
+// Files are only copied for issues whose preview is not ready already.
+void AutoTidy::prefetch(std::vector<int> const& upcoming)
+{
+    std::vector<PreviewJob> jobs;
+    for (auto index : upcoming) {
+        ScopedTimer timer{timings[CopyPhase]};
+        auto const& err = errorList[index];
+        auto versions = previewVersions(err);
+        if (previewer.ready(err.number, versions)) {
+            PreviewJob job;
+            job.issue = err.number;
+            job.versions = std::move(versions);
+            jobs.push_back(std::move(job));
+        } else {
+            try {
+                jobs.push_back(makePreviewJob(err));
+            } catch (io_exception&) {
+                // Reported if the issue is shown, like without prefetching
+            }
+        }
+    }
+    previewer.schedule(std::move(jobs));
+}
+
+// Show the man page of a check in a pager. Pages are rendered the first
+// time they are shown, and again only if the terminal width changed.
+// Returns false if the check has no documentation.
+bool AutoTidy::pageDoc(std::string const& check)
+{
+    int rows = 0;
+    int columns = 0;
+    std::tie(rows, columns) = terminalSize();
+    auto width = static_cast<size_t>(std::max(columns - 1, 20));
+    auto& doc = docPages[check];
+    if (doc.first != width) {
+        auto page = docPage(check);
+        if (page.empty()) {
+            return false;
+        }
+        doc.first = width;
+        doc.second = ManRenderer{width}.render(page);
+    }
+    auto const& lines = doc.second;
 
-    if (ignores.count(err.check) > 0 || err.fileName.empty()) {
+    size_t top = 0;
+    while (true) {
+        std::tie(rows, columns) = terminalSize();
+        auto height = static_cast<size_t>(std::max(rows - 1, 1));
+        auto last = lines.size() > height ? lines.size() - height : 0;
+        top = std::min(top, last);
+
+        show("\x1b[H\x1b[2J");
+        for (auto row = top; row < std::min(top + height, lines.size());
+             row++) {
+            show(lines[row] + "\n");
+        }
+        show(fmt::fg(fmt::color::cyan),
+             "{} ({}-{} of {}) [j/k] line, [space/b] page, [g/G] first/last, "
+             "[q] back ",
+             check, top + 1, std::min(top + height, lines.size()),
+             lines.size());
+        flushScreen();
+
+        switch (readKey()) {
+        case 'j':
+        case '\n':
+        case '\r':
+            top++;
+            break;
+        case 'k':
+            top = top > 0 ? top - 1 : 0;
+            break;
+        case ' ':
+            top += height;
+            break;
+        case 'b':
+            top = top > height ? top - height : 0;
+            break;
+        case 'g':
+            top = 0;
+            break;
+        case 'G':
+            top = last;
+            break;
+        case 'q':
+        case 'd':
+            return true;
+        default:
+            break;
+        }
+    }
+}
+
+bool AutoTidy::showDoc(TidyError const& err)
+{
+    if (!pageDoc(err.check)) {
+        show(fmt::format("No documentation for {}\n", err.check));
         return false;
     }
-    if (skippedFiles.count(err.fileName) > 0) {
+    show("\x1b[H\x1b[2J");
+    printError(err);
+    return false;
+}
+
+// Read a line of text after a prompt. Returns false if it was cancelled
+// with escape.
+bool AutoTidy::readLine(std::string const& prompt, std::string& text)
+{
+    while (true) {
+        show("\r\x1b[K");
+        show(fmt::fg(fmt::color::cyan), "{}", prompt);
+        show(text);
+        flushScreen();
+        auto c = readKey();
+        if (c == '\n' || c == '\r') {
+            show("\n");
+            return true;
+        }
+        if (c == 0x1b) {
+            show("\n");
+            return false;
+        }
+        if ((c == 0x7f || c == '\b') && !text.empty()) {
+            text.pop_back();
+        } else if (c >= 0x20 && c < 0x7f) {
+            text += c;
+        }
+    }
+}
+
+// Search the docs of all checks, and list the best matches to pick a page
+// to show
+bool AutoTidy::findDocs(TidyError const& err)
+{
+    std::string query;
+    std::vector<DocMatch> matches;
+    size_t cursor = 0;
+    size_t top = 0;
+    bool ask = true;
+    while (true) {
+        if (ask) {
+            if (!readLine("Search docs: ", query) || query.empty()) {
+                show("\x1b[H\x1b[2J");
+                printError(err);
+                return false;
+            }
+            matches = searchDocs(query);
+            top = cursor = 0;
+            ask = false;
+        }
+        int rows = 0;
+        int columns = 0;
+        std::tie(rows, columns) = terminalSize();
+        auto height = static_cast<size_t>(std::max(rows - 2, 1));
+        cursor = std::min(cursor, matches.empty() ? 0 : matches.size() - 1);
+        if (cursor < top) {
+            top = cursor;
+        } else if (cursor >= top + height) {
+            top = cursor - height + 1;
+        }
+
+        show("\x1b[H\x1b[2J");
+        show(fmt::fg(fmt::color::cyan), "{} checks match '{}'\n",
+             matches.size(), query);
+        for (auto row = top; row < std::min(top + height, matches.size());
+             row++) {
+            fmt::text_style style;
+            if (row == cursor) {
+                style = fmt::bg(fmt::color::white) | fmt::fg(fmt::color::black);
+            }
+            show(style, "{:6.2f} {}", matches[row].score, matches[row].name);
+            show("\n");
+        }
+        show(fmt::fg(fmt::color::cyan),
+             "[j/k] move, [enter] show doc, [/] new search, [q] back ");
+        flushScreen();
+
+        switch (readKey()) {
+        case 'j':
+            cursor++;
+            break;
+        case 'k':
+            cursor = cursor > 0 ? cursor - 1 : 0;
+            break;
+        case '\n':
+        case '\r':
+            if (!matches.empty()) {
+                pageDoc(matches[cursor].name);
+            }
+            break;
+        case '/':
+            show("\x1b[H\x1b[2J");
+            query.clear();
+            ask = true;
+            break;
+        case 'q':
+            show("\x1b[H\x1b[2J");
+            printError(err);
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+// A scrollable list of the issues, or of the number of issues of each
+// check, file or directory. Only the rows that fit on screen are rendered.
+// Returns true if an issue was picked, and triage continues from there
+// with the listed issues.
+bool AutoTidy::listIssues(TidyError const& err)
+{
+    static std::array<char const*, IssueIndex::GroupCount + 1> const
+        groupNames{{"check", "category", "file", "directory", "issue"}};
+
+    if (issueIndex.empty()) {
+        for (auto i : triageIssues) {
+            auto const& e = errorList[i];
+            issueIndex.add(i, e.check, e.fileName.string(),
+                           e.fileName.parent_path().string());
+        }
+        listed = issueIndex.all();
+        listFilters.clear();
+    }
+
+    auto grouping = IssueIndex::GroupCount;
+    std::vector<std::pair<uint32_t, size_t>> groups;
+    size_t top = 0;
+    size_t cursor = 0;
+    for (size_t i = 0; i < listed.size(); i++) {
+        if (issueIndex.issue(listed[i]) == err.number) {
+            cursor = i;
+            break;
+        }
+    }
+
+    while (true) {
+        int rows = 0;
+        int columns = 0;
+        std::tie(rows, columns) = terminalSize();
+        auto height = static_cast<size_t>(std::max(rows - 2, 1));
+        auto width = static_cast<size_t>(std::max(columns - 1, 1));
+        auto count = grouping == IssueIndex::GroupCount ? listed.size()
+                                                        : groups.size();
+        cursor = std::min(cursor, count > 0 ? count - 1 : 0);
+        if (cursor < top) {
+            top = cursor;
+        } else if (cursor >= top + height) {
+            top = cursor - height + 1;
+        }
+
+        show("\x1b[H\x1b[2J");
+        show(fmt::fg(fmt::color::cyan), "{} issues{}{}", listed.size(),
+             listFilters.empty() ? "" : " in ",
+             absl::StrJoin(listFilters, ", "));
+        if (grouping != IssueIndex::GroupCount) {
+            show(fmt::fg(fmt::color::cyan), ", by {}", groupNames[grouping]);
+        }
+        show("\n");
+
+        for (auto row = top; row < std::min(top + height, count); row++) {
+            std::string text;
+            fmt::text_style style;
+            if (grouping == IssueIndex::GroupCount) {
+                auto& e = errorList[issueIndex.issue(listed[row])];
+                reanchor(e.fileName);
+                text = fmt::format("#{} {}:{} [{}] {}", e.number,
+                                   displayName(e.fileName), e.line, e.check,
+                                   e.error);
+                if (isIgnored(e)) {
+                    style = fmt::fg(fmt::color::dim_gray);
+                }
+            } else {
+                auto const& name = issueIndex.name(grouping, groups[row].first);
+                text = fmt::format("{:>8} {}", groups[row].second,
+                                   grouping < IssueIndex::File
+                                       ? name
+                                       : displayName(name));
+            }
+            if (text.length() > width) {
+                text.resize(width);
+            }
+            if (row == cursor) {
+                style = fmt::bg(fmt::color::white) | fmt::fg(fmt::color::black);
+            }
+            show(style, "{}", text);
+            show("\n");
+        }
+        show(fmt::fg(fmt::color::cyan),
+             "[j/k] move, [space/b] page, [g/G] first/last, [enter] {}, "
+             "[tab] by {}, [x] clear filters, [q] back ",
+             grouping == IssueIndex::GroupCount ? "go to issue" : "filter",
+             groupNames[(grouping + 1) % (IssueIndex::GroupCount + 1)]);
+        flushScreen();
+
+        switch (readKey()) {
+        case 'j':
+            cursor++;
+            break;
+        case 'k':
+            cursor = cursor > 0 ? cursor - 1 : 0;
+            break;
+        case ' ':
+            cursor += height;
+            break;
+        case 'b':
+            cursor = cursor > height ? cursor - height : 0;
+            break;
+        case 'g':
+            cursor = 0;
+            break;
+        case 'G':
+            cursor = count;
+            break;
+        case '\t':
+            grouping = static_cast<IssueIndex::Group>(
+                (grouping + 1) % (IssueIndex::GroupCount + 1));
+            if (grouping != IssueIndex::GroupCount) {
+                groups = issueIndex.counts(listed, grouping);
+            }
+            top = cursor = 0;
+            break;
+        case 'x':
+            listed = issueIndex.all();
+            listFilters.clear();
+            grouping = IssueIndex::GroupCount;
+            top = cursor = 0;
+            break;
+        case '\n':
+        case '\r': {
+            if (count == 0) {
+                break;
+            }
+            if (grouping == IssueIndex::GroupCount) {
+                issueQueue.clear();
+                issueQueue.reserve(listed.size());
+                for (auto p : listed) {
+                    issueQueue.push_back(issueIndex.issue(p));
+                }
+                nextIssue = cursor;
+                show("\x1b[H\x1b[2J");
+                return true;
+            }
+            auto key = groups[cursor].first;
+            auto const& name = issueIndex.name(grouping, key);
+            listed = issueIndex.filter(listed, grouping, key);
+            listFilters.push_back(grouping < IssueIndex::File
+                                      ? name
+                                      : displayName(name));
+            grouping = IssueIndex::GroupCount;
+            top = cursor = 0;
+            break;
+        }
+        case 'q':
+        case 'l':
+            show("\x1b[H\x1b[2J");
+            printError(err);
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+bool AutoTidy::handleError(const TidyError& err)
+{
+    static auto const separatorString = std::string(60, '-') + "\n";
+
+    if (isIgnored(err) || applyRule(err)) {
         return false;
     }
+    flushRuleFixes();
+    reanchor(err.fileName);
+    askedCount++;
 
     printError(err);
-    tempFiles.clear();
 
-    // Make copies of the files in the error and work on the copies instead.
-    // Then we apply fixes to the copies an use 'diff' to show the changes.
-    for (auto const& r : err.replacements) {
-        auto temp = r.path + ".temp";
-        if (!contains(tempFiles, r.path)) {
-            tempFiles[r.path] = temp;
-            // We copy via the replacer since it needs to keep
-            // track of all files with possible replacements
-            replacer.copyFile(temp, r.path);
+    // Use the preview prepared by triage(), unless an earlier decision
+    // changed the files it was made from. Otherwise the fixes are applied
+    // to copies of the files, and 'diff' is used to show the changes.
+    if (preview.issue != err.number ||
+        preview.versions != previewVersions(err)) {
+        PreviewJob job;
+        {
+            ScopedTimer timer{timings[CopyPhase]};
+            job = makePreviewJob(err);
         }
-        // Patch the temporary file
-        replacer.applyReplacement({temp, r});
+        preview = Previewer::render(std::move(job), diffCommand);
+    }
+    if (preview.hasPatch) {
+        timings[PatchPhase].add(preview.patchTime);
+        timings[DiffPhase].add(preview.diffTime);
     }
 
     bool quitProgram = false;
     while (true) {
-        // Show diff between patched temp files and original file
-        for (auto const& p : tempFiles) {
-            system(fmt::format(diffCommand, std::get<RealName>(p), // NOLINT
-                               std::get<TempName>(p))
-                       .c_str());
-        }
+        show(preview.diff);
 
         char c = promptUser();
         quitProgram = (c == 'q');
@@ -162,17 +818,23 @@ bool AutoTidy::handleError(const TidyError& err)
         }
     }
 
-    fmt::print(fmt::fg(fmt::color::steel_blue), separatorString);
-    for (auto const& f : tempFiles) {
-        replacer.removeFile(std::get<TempName>(f));
-    }
-
+    show(fmt::fg(fmt::color::steel_blue), "{}", separatorString);
     return quitProgram;
 }
 
+void AutoTidy::readRules(utils::path const& fileName)
+{
+    if (!utils::exists(fileName)) {
+        return;
+    }
+    for (auto const& warning : rules.read(fileName.string())) {
+        fmt::print("**Warning: {}\n", warning);
+    }
+}
+
 void AutoTidy::readConfig()
 {
-    std::ifstream configFile(".clang-tidy");
+    std::ifstream configFile(configFilename);
 
     std::string line;
     while (std::getline(configFile, line)) {
@@ -182,13 +844,8 @@ void AutoTidy::readConfig()
             if (lastQuote > firstQuote && firstQuote != std::string::npos) {
                 auto checks =
                     line.substr(firstQuote + 1, lastQuote - firstQuote - 1);
-                for (const auto& checkName : absl::StrSplit(checks, ',')) {
-                    auto strippedName =
-                        absl::StripLeadingAsciiWhitespace(checkName);
-                    if (strippedName.front() == '-') {
-                        ignores.emplace(strippedName.substr(1));
-                    }
-                }
+                checkFilter.setChecks(checks);
+                configs.setDefaultChecks(checks);
             }
         }
         confLines.push_back(line);
@@ -211,24 +868,30 @@ void AutoTidy::readTidyLog()
 
     std::regex errline{R"((([^:]+):(\d+):(\d+):)?\s*(\w+):\s*(.*)\[(.*)\])"};
 
-    std::vector<std::string> text;
+    // The text following each issue is not kept, only where it is in the
+    // log, since it can be huge
+    size_t position = 0;
+    auto endText = [&](TidyError& err, size_t end) {
+        err.textLength = end > err.textOffset ? end - err.textOffset - 1 : 0;
+    };
+
     TidyError error;
     int errorNo = 0;
     std::string line;
-    std::ifstream logFile(filename);
+    std::ifstream logFile(filename, std::ios::binary);
     while (std::getline(logFile, line)) {
+        auto lineStart = position;
+        position += line.length() + 1;
         std::cmatch currentMatch;
         if (std::regex_match(line.c_str(), currentMatch, errline)) {
             if (currentMatch[Type] == "note") {
-                text.push_back(line);
                 continue;
             }
 
             if (!error.error.empty()) {
+                endText(error, lineStart);
                 errorList.push_back(error);
-                errorList.back().text = absl::StrJoin(text, "\n");
             }
-            text.clear();
 
             error = {errorNo++,
                      currentMatch[Check],
@@ -236,13 +899,13 @@ void AutoTidy::readTidyLog()
                      std::atoi(currentMatch[Column].str().c_str()),
                      utils::path{currentMatch[Filename]},
                      currentMatch[Message]};
-        } else {
-            text.push_back(line);
+            error.checkId = checkFilter.intern(error.check);
+            error.textOffset = position;
         }
     }
     if (!error.error.empty()) {
+        endText(error, position);
         errorList.push_back(error);
-        errorList.back().text = absl::StrJoin(text, "\n");
     }
 }
 
@@ -284,11 +947,18 @@ void AutoTidy::readFixes()
 
 void AutoTidy::setIgnores(std::set<std::string> const& ignores)
 {
-    this->ignores = ignores;
+    checkFilter.setChecks("*");
+    for (auto const& check : ignores) {
+        checkFilter.add("-" + check);
+    }
 }
 
-void AutoTidy::run()
+void AutoTidy::load()
 {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
     currDir = currentDir();
     if (!absl::EndsWith(currDir, "/")) {
         currDir += "/";
@@ -297,10 +967,462 @@ void AutoTidy::run()
     readConfig();
     readTidyLog();
     readFixes();
+    locateIssues();
+    resolveChecks();
+}
+
+// Find out which issues have checks that are turned off for their file.
+// Files in the same directory share the same answer, so each directory is
+// only looked up once.
+void AutoTidy::resolveChecks()
+{
+    std::string lastDir;
+    CheckFilter* filter = nullptr;
+    for (auto& err : errorList) {
+        if (err.fileName.empty()) {
+            continue;
+        }
+        auto dir = err.fileName.parent_path().string();
+        if (!err.fileName.is_absolute()) {
+            dir = currDir + dir;
+            if (dir.size() > 1 && dir.back() == '/') {
+                dir.pop_back();
+            }
+        }
+        if (filter == nullptr || dir != lastDir) {
+            filter = &configs.filterFor(dir);
+            lastDir = dir;
+        }
+        err.disabled = filter->hides(err.check);
+    }
+}
+
+// Find the offset of every issue in its file, reading each file once
+void AutoTidy::locateIssues()
+{
+    for (auto const& err : errorList) {
+        if (!err.fileName.empty()) {
+            fileIssues[err.fileName].push_back(err.number);
+        }
+    }
+    for (auto& f : fileIssues) {
+        auto& issues = f.second;
+        std::stable_sort(issues.begin(), issues.end(), [&](int a, int b) {
+            return std::tie(errorList[a].line, errorList[a].column) <
+                   std::tie(errorList[b].line, errorList[b].column);
+        });
+        if (!utils::exists(f.first)) {
+            continue;
+        }
+        auto contents = readFile(f.first);
+        size_t pos = 0;
+        int line = 1;
+        for (auto i : issues) {
+            auto& err = errorList[i];
+            for (; line < err.line && pos < contents.size(); pos++) {
+                if (contents[pos] == '\n') {
+                    line++;
+                }
+            }
+            auto column = static_cast<size_t>(std::max(err.column, 1));
+            err.offset = std::min(pos + column - 1, contents.size());
+        }
+    }
+}
+
+// Save what is needed to continue the triage later, without running
+// clang-tidy again; the issues, the decisions made and the patch state of
+// the changed files
+void AutoTidy::saveSession(std::vector<int> const& remaining)
+{
+    auto numbers = [](auto const& issues) {
+        std::vector<std::string> fields;
+        for (auto i : issues) {
+            fields.push_back(std::to_string(i));
+        }
+        return fields;
+    };
+
+    utils::remove(sessionFile);
+    Journal session{sessionFile};
+    session.write('L', {filename.string()});
+    for (auto const& err : errorList) {
+        std::vector<std::string> fields{
+            std::to_string(err.number), err.check,
+            std::to_string(err.line),   std::to_string(err.column),
+            std::to_string(err.offset), err.fileName.string(),
+            err.error,                  std::to_string(err.textOffset),
+            std::to_string(err.textLength)};
+        for (auto const& r : err.replacements) {
+            fields.insert(fields.end(), {r.path, std::to_string(r.offset),
+                                         std::to_string(r.length), r.text});
+        }
+        session.write('E', fields);
+    }
+    replacer.saveState(session);
+    session.write('S', {skippedFiles.begin(), skippedFiles.end()});
+    session.write('R', numbers(resolved));
+    session.write('A', numbers(askAlways));
+    session.write('Q', numbers(remaining));
+    session.sync();
+}
+
+bool AutoTidy::resume()
+{
+    if (!utils::exists(sessionFile)) {
+        return false;
+    }
+    currDir = currentDir();
+    if (!absl::EndsWith(currDir, "/")) {
+        currDir += "/";
+    }
+    readConfig();
+
+    std::vector<int> queue;
+    Journal session{sessionFile};
+    for (auto const& record : session.read()) {
+        auto const& f = record.fields;
+        switch (record.type) {
+        case 'L':
+            filename = f.empty() ? "" : f[0];
+            break;
+        case 'E': {
+            if (f.size() < 9) {
+                break;
+            }
+            TidyError err{std::stoi(f[0]), f[1],
+                          std::stoi(f[2]), std::stoi(f[3]),
+                          utils::path{f[5]}, f[6]};
+            err.checkId = checkFilter.intern(err.check);
+            err.offset = std::stoull(f[4]);
+            err.textOffset = std::stoull(f[7]);
+            err.textLength = std::stoull(f[8]);
+            for (size_t i = 9; i + 3 < f.size(); i += 4) {
+                err.replacements.emplace_back(f[i], std::stoull(f[i + 1]),
+                                              std::stoull(f[i + 2]),
+                                              f[i + 3]);
+            }
+            errorList.push_back(std::move(err));
+            break;
+        }
+        case 'P':
+            replacer.restoreState(record);
+            break;
+        case 'S':
+            skippedFiles.insert(f.begin(), f.end());
+            break;
+        case 'R':
+        case 'A':
+        case 'Q':
+            for (auto const& number : f) {
+                auto i = std::stoi(number);
+                if (record.type == 'R') {
+                    resolved.insert(i);
+                } else if (record.type == 'A') {
+                    askAlways.insert(i);
+                } else {
+                    queue.push_back(i);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (auto const& err : errorList) {
+        if (!err.fileName.empty()) {
+            fileIssues[err.fileName].push_back(err.number);
+        }
+    }
+    for (auto& f : fileIssues) {
+        std::stable_sort(f.second.begin(), f.second.end(), [&](int a, int b) {
+            return errorList[a].offset < errorList[b].offset;
+        });
+    }
+    resolveChecks();
+
+    triage(queue);
+    replacer.finish();
+    return true;
+}
+
+// Map the issues of a file to their current line and column, if the file
+// has been changed since they were last updated
+void AutoTidy::reanchor(std::string const& fileName)
+{
+    auto version = replacer.version(fileName);
+    auto& anchored = anchoredVersions[fileName];
+    if (version == anchored || !contains(fileIssues, fileName)) {
+        return;
+    }
+    anchored = version;
+
+    auto const& issues = fileIssues[fileName];
+    std::vector<size_t> offsets;
+    offsets.reserve(issues.size());
+    for (auto i : issues) {
+        offsets.push_back(errorList[i].offset);
+    }
+    auto positions = replacer.lineColumns(fileName, offsets);
+    for (size_t i = 0; i < issues.size(); i++) {
+        auto& err = errorList[issues[i]];
+        std::tie(err.line, err.column) = positions[i];
+    }
+}
+
+void AutoTidy::triage(std::vector<int> const& issues)
+{
+    RawTerminal rawTerminal;
+    auto start = std::chrono::steady_clock::now();
+    triageIssues = issues;
+    issueIndex = {};
+    issueQueue = issues;
+    nextIssue = 0;
+    int current = -1;
+    bool quit = false;
+    while (nextIssue < issueQueue.size() || !revisit.empty()) {
+        int index = 0;
+        if (!revisit.empty()) {
+            index = revisit.back();
+            revisit.pop_back();
+        } else {
+            index = issueQueue[nextIssue++];
+        }
+
+        // Issues to be revisited come first, then the rest of the list
+        std::vector<int> upcoming(revisit.rbegin(), revisit.rend());
+        for (size_t i = nextIssue;
+             i < issueQueue.size() && upcoming.size() < previewAhead; i++) {
+            auto const& other = errorList[issueQueue[i]];
+            if (!isIgnored(other) &&
+                (rules.match(displayName(other.fileName), other.check) ==
+                     Rules::None ||
+                 contains(askAlways, other.number))) {
+                upcoming.push_back(issueQueue[i]);
+            }
+        }
+        // Take the prepared preview of this issue first, since scheduling
+        // drops the previews that are not wanted any more
+        if (!previewer.take(index, preview)) {
+            preview = {};
+        }
+        prefetch(upcoming);
+
+        current = index;
+        auto asked = askedCount;
+        auto issueStart = std::chrono::steady_clock::now();
+        quit = handleError(errorList[index]);
+        if (askedCount > asked) {
+            std::chrono::duration<double, std::milli> ms =
+                std::chrono::steady_clock::now() - issueStart;
+            timings[IssuePhase].add(ms.count());
+        }
+        if (quit) {
+            break;
+        }
+        // Rejected rule decisions are asked about before moving on
+        if (revisit.empty() && nextIssue == issueQueue.size()) {
+            flushRuleFixes();
+        }
+    }
+    flushRuleFixes();
+
+    if (quit) {
+        std::vector<int> remaining{current};
+        remaining.insert(remaining.end(), revisit.rbegin(), revisit.rend());
+        remaining.insert(remaining.end(), issueQueue.begin() + nextIssue,
+                         issueQueue.end());
+        saveSession(remaining);
+        show(fmt::fg(fmt::color::cyan),
+             "Session saved, continue with --resume\n");
+    } else {
+        utils::remove(sessionFile);
+    }
+
+    if (replayFile.is_open()) {
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        auto const& perIssue = timings[IssuePhase];
+        show(fmt::fg(fmt::color::cyan),
+             "Replayed {} keys for {} issues in {:.1f} ms; per issue p50 "
+             "{:.2f} ms, p99 {:.2f} ms, max {:.2f} ms\n",
+             replayedKeys, askedCount, ms.count(), perIssue.percentile(0.5),
+             perIssue.percentile(0.99), perIssue.max());
+    }
+
+    if (printTimings || !timingsFile.empty()) {
+        reportTimings();
+    }
+
+    if (!rules.empty()) {
+        std::chrono::duration<double> seconds =
+            std::chrono::steady_clock::now() - start;
+        size_t decided = 0;
+        std::vector<std::string> actions;
+        for (size_t a = Rules::Apply; a < Rules::ActionCount; a++) {
+            decided += ruleCounts[a];
+            if (ruleCounts[a] > 0) {
+                actions.push_back(fmt::format(
+                    "{} {}", ruleCounts[a],
+                    Rules::actionName(static_cast<Rules::Action>(a))));
+            }
+        }
+        show(fmt::fg(fmt::color::cyan),
+             "Rules decided {} issues ({}), {} were asked about, {:.1f} "
+             "issues/s\n",
+             decided, absl::StrJoin(actions, ", "), askedCount,
+             static_cast<double>(decided + askedCount) /
+                 std::max(seconds.count(), 0.001));
+    }
+    flushScreen();
+}
+
+// Decide about an issue without asking, if a rule matches it. Changes are
+// collected, and applied as one step before the next question. Returns
+// true if the issue was decided.
+bool AutoTidy::applyRule(TidyError const& err)
+{
+    if (rules.empty() || contains(askAlways, err.number)) {
+        return false;
+    }
+    auto action = rules.match(displayName(err.fileName), err.check);
+    reanchor(err.fileName);
+    switch (action) {
+    case Rules::None:
+    case Rules::ActionCount:
+        return false;
+    case Rules::Apply:
+        if (err.replacements.empty()) {
+            return false;
+        }
+        ruleFixes.push_back(err.replacements);
+        break;
+    case Rules::Nolint:
+        ruleFixes.push_back({replacer.appendReplacement(
+            err.fileName, err.line, " //NOLINT")});
+        break;
+    case Rules::NolintCheck:
+        ruleFixes.push_back({replacer.appendReplacement(
+            err.fileName, err.line, fmt::format(" //NOLINT({})", err.check))});
+        break;
+    case Rules::Todo:
+        ruleFixes.push_back({replacer.appendReplacement(
+            err.fileName, err.line, fmt::format(" //TODO({})", err.check))});
+        break;
+    case Rules::Skip:
+        ruleCounts[action]++;
+        return true;
+    }
+    ruleIssues.push_back(err.number);
+    ruleActions.push_back(action);
+    return true;
+}
+
+void AutoTidy::flushRuleFixes()
+{
+    if (ruleFixes.empty()) {
+        return;
+    }
+    auto rejected = replacer.applyFixes(ruleFixes);
+
+    std::vector<int> applied;
+    auto nextRejected = rejected.begin();
+    for (size_t i = 0; i < ruleIssues.size(); i++) {
+        if (nextRejected != rejected.end() && *nextRejected == i) {
+            ++nextRejected;
+            askAlways.insert(ruleIssues[i]);
+            revisit.push_back(ruleIssues[i]);
+            continue;
+        }
+        applied.push_back(ruleIssues[i]);
+        resolved.insert(ruleIssues[i]);
+        ruleCounts[ruleActions[i]]++;
+    }
+    // Ask about rejected issues in list order
+    std::reverse(revisit.end() - static_cast<int64_t>(rejected.size()),
+                 revisit.end());
 
+    if (!applied.empty()) {
+        undoIssues.push_back(applied);
+        redoIssues.clear();
+    }
+    ruleFixes.clear();
+    ruleIssues.clear();
+    ruleActions.clear();
+}
+
+void AutoTidy::run()
+{
+    load();
+
+    // Handle the issues one file at a time, so file buffers evicted to
+    // stay within the memory budget are rarely needed again
+    std::vector<std::string> fileNames;
     for (auto const& e : errorList) {
-        if (handleError(e)) {
-            return;
+        fileNames.push_back(e.fileName.string());
+    }
+    std::vector<int> issues(errorList.size());
+    std::iota(issues.begin(), issues.end(), 0);
+    std::stable_sort(issues.begin(), issues.end(), [&](int a, int b) {
+        return fileNames[a] < fileNames[b];
+    });
+    triage(issues);
+    replacer.finish();
+}
+
+void AutoTidy::applyAll(bool deferConflicts)
+{
+    load();
+
+    std::vector<std::vector<Replacement>> fixes;
+    std::vector<int> issues;
+    for (auto const& e : errorList) {
+        if (e.replacements.empty() || e.fileName.empty() ||
+            e.disabled) {
+            continue;
+        }
+        fixes.push_back(e.replacements);
+        issues.push_back(e.number);
+    }
+
+    // All fixes are applied in one pass per file
+    auto rejected = replacer.applyFixes(fixes);
+    fmt::print("Applied {} fixes", fixes.size() - rejected.size());
+    if (!rejected.empty()) {
+        fmt::print(", {} fixes conflicted with an earlier fix and were "
+                   "skipped",
+                   rejected.size());
+    }
+    fmt::print("\n");
+
+    // The batch is one undo step, so undoing it brings back all of its
+    // issues
+    std::vector<int> applied;
+    auto nextRejected = rejected.begin();
+    for (size_t i = 0; i < issues.size(); i++) {
+        if (nextRejected != rejected.end() && *nextRejected == i) {
+            ++nextRejected;
+            continue;
+        }
+        applied.push_back(issues[i]);
+        resolved.insert(issues[i]);
+    }
+    if (!applied.empty()) {
+        undoIssues.push_back(applied);
+        redoIssues.clear();
+    }
+
+    if (deferConflicts) {
+        // The conflicting fixes overlap applied ones, so they can never be
+        // applied. Their issues are reviewed without them, to be handled
+        // by hand.
+        std::vector<int> deferred;
+        for (auto i : rejected) {
+            errorList[issues[i]].replacements.clear();
+            deferred.push_back(issues[i]);
         }
+        triage(deferred);
     }
+    replacer.finish();
 }
@@ -1,10 +1,25 @@
 #pragma once
 
+#include "check_filter.h"
+#include "config_resolver.h"
+#include "histogram.h"
+#include "issue_index.h"
 #include "path.h"
+#include "preview.h"
 #include "replacer.h"
+#include "rules.h"
 
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct TidyError
@@ -17,17 +32,29 @@ struct TidyError
     {}
     int number = 0;
     std::string check;
+    uint32_t checkId = 0;
+    // Check is turned off by the .clang-tidy that applies to the file
+    bool disabled = false;
+    // Current position, kept up to date as the file is patched
     int line = 0;
     int column = 0;
+    // Position in the original file
+    size_t offset = 0;
     utils::path fileName;
     std::string error;
-    std::string text;
+    // Where the notes and source excerpt following the issue are in the
+    // log, they are read when shown
+    size_t textOffset = 0;
+    size_t textLength = 0;
     std::vector<Replacement> replacements;
 };
 
 class AutoTidy
 {
-    std::set<std::string> ignores;
+    CheckFilter checkFilter;
+    ConfigResolver configs;
+    // Checks ignored with [i], in any directory
+    std::set<uint32_t> ignoredChecks;
     std::vector<std::string> confLines;
     std::string currDir;
     Replacer replacer;
@@ -36,43 +63,188 @@ class AutoTidy
     utils::path configFilename;
     std::string diffCommand;
     utils::path fixesFile;
+    utils::path sessionFile = ".autotidy/session";
     std::vector<TidyError> errorList;
+    // Set once the log and fixes are read
+    bool loaded = false;
+
+    // Issue numbers of the steps that can be undone/redone
+    std::vector<std::vector<int>> undoIssues;
+    std::vector<std::vector<int>> redoIssues;
+    // Issues to show again before continuing with the list
+    std::vector<int> revisit;
+    // Issues that are going through triage, and the next one to show
+    std::vector<int> triageIssues;
+    std::vector<int> issueQueue;
+    size_t nextIssue = 0;
+    // Issues fixed by a bulk action
+    std::set<int> resolved;
+
+    // Issues of each file in order of position, and the version of the
+    // file that their line and column were last updated for
+    std::map<std::string, std::vector<int>> fileIssues;
+    std::map<std::string, size_t> anchoredVersions;
+
+    // Rendered man pages of checks, and the width they were rendered for
+    std::map<std::string, std::pair<size_t, std::vector<std::string>>>
+        docPages;
+
+    // Set when notes of the shown issue were left out
+    bool notesCollapsed = false;
+
+    // Everything shown is collected here, and written to the terminal at
+    // once before waiting for a key
+    fmt::memory_buffer screen;
+
+    template <typename... Args>
+    void show(fmt::text_style const& style, char const* format,
+              Args const&... args)
+    {
+        fmt::format_to(std::back_inserter(screen), style, format, args...);
+    }
+    void show(std::string const& text)
+    {
+        screen.append(text.data(), text.data() + text.size());
+    }
+    void flushScreen();
 
-    enum
+    // Keys are logged to recordFile, and read from replayFile instead of
+    // the terminal, to benchmark the whole triage loop
+    std::ofstream recordFile;
+    std::ifstream replayFile;
+    size_t replayedKeys = 0;
+    char readKey();
+
+    // Time spent in each phase of showing an issue. Response is the time
+    // from a key press until the next screen is shown, and issue the
+    // whole time spent on each issue that was asked about.
+    enum Phase
     {
-        RealName,
-        TempName
+        CopyPhase,
+        PatchPhase,
+        DiffPhase,
+        NotesPhase,
+        RenderPhase,
+        ResponsePhase,
+        IssuePhase,
+        PhaseCount
     };
-    std::map<std::string, std::string> tempFiles;
+    std::array<Histogram, PhaseCount> timings;
+    std::chrono::steady_clock::time_point keyTime;
+    bool keyPressed = false;
+    bool printTimings = false;
+    utils::path timingsFile;
+    void reportTimings();
+
+    // Decisions made by rules, waiting to be applied in one step
+    Rules rules;
+    std::vector<std::vector<Replacement>> ruleFixes;
+    std::vector<int> ruleIssues;
+    std::vector<Rules::Action> ruleActions;
+    // Issues to ask about even if a rule matches, since the decision of
+    // the rule could not be applied or was undone
+    std::set<int> askAlways;
+    // Issues resolved by each action of the rules, and by asking
+    std::array<size_t, Rules::ActionCount> ruleCounts{};
+    size_t askedCount = 0;
+
+    // The list view; the issues in it after filtering, and the filters
+    IssueIndex issueIndex;
+    std::vector<uint32_t> listed;
+    std::vector<std::string> listFilters;
+
+    // Diff of the current issue, and previews of the next ones
+    Preview preview;
+    Previewer previewer;
+    size_t previewAhead = 3;
 
     std::string helpText =
         R"([?] = This help text
 [a] = Apply the shown patch, if this issue has a Fix
+[A] = Apply the fixes of all remaining issues of this check
+[I] = Apply all remaining fixes identical to this one
 [i] = Ignore this check, add it to list of ignored checks in .clang-tidy
 [s] = Skip this issue
 [S] = Skip all issues in this file
 [n] = Add a NOLINT comment to the line where the issue appears
 [N] = As above, but only for the current check
 [d] = Show documentation on the current check
+[/] = Search the documentation of all checks
+[e] = Expand notes that were collapsed
+[l] = List all issues, and filter them by check, category, file or
+      directory
 [t] = Add a TODO comment to the line where the issue appears
+[u] = Undo the last applied change, and revisit its issue
+[r] = Redo the last undone change
 [q] = Quit autotidy)";
 
     void readTidyLog();
     void readFixes();
+    void locateIssues();
+    void resolveChecks();
+    void saveSession(std::vector<int> const& remaining);
+    void reanchor(std::string const& fileName);
 
     char promptUser();
+    void applyChange(TidyError const& err,
+                     std::vector<Replacement> const& replacements);
+    void applySimilar(TidyError const& err, bool sameFix, bool wholeProject);
+    std::string fixSignature(TidyError const& err,
+                             std::map<std::string, PatchedFile>& files);
+    char promptScope();
     bool handleKey(char c, TidyError const& err);
+    std::string displayName(utils::path const& fileName) const;
     void printError(TidyError const& err);
+    std::string readNotes(TidyError const& err) const;
+    bool listIssues(TidyError const& err);
+    bool pageDoc(std::string const& check);
+    bool showDoc(TidyError const& err);
+    bool readLine(std::string const& prompt, std::string& text);
+    bool findDocs(TidyError const& err);
+    bool applyRule(TidyError const& err);
+    void flushRuleFixes();
     bool handleError(TidyError const& err);
+    bool isIgnored(TidyError const& err) const;
+    std::map<std::string, size_t>
+    previewVersions(TidyError const& err) const;
+    PreviewJob makePreviewJob(TidyError const& err) const;
+    void prefetch(std::vector<int> const& upcoming);
+    void triage(std::vector<int> const& issues);
 
 public:
     AutoTidy(utils::path const& aFilename, utils::path const& aConfigFilename,
              std::string const& aDiffCommand, utils::path const& aFixesFile)
         : filename(aFilename), configFilename(aConfigFilename),
-          diffCommand(aDiffCommand), fixesFile(aFixesFile)
+          diffCommand(aDiffCommand), fixesFile(aFixesFile),
+          previewer(aDiffCommand)
     {}
+    // Read the config, log and fixes. run() and applyAll() do this unless
+    // it was done before.
+    void load();
     void run();
+    // Continue the triage of an earlier session that was quit, returns
+    // false if there is none
+    bool resume();
+    // Log all keys pressed to a file
+    void recordKeys(utils::path const& fileName);
+    // Read keys from a file recorded earlier instead of the terminal, and
+    // report the time taken at the end
+    bool replayKeys(utils::path const& fileName);
+    // Print the time spent in each phase at exit, and/or save it as JSON
+    void setTimings(bool print, utils::path const& jsonFile)
+    {
+        printTimings = print;
+        timingsFile = jsonFile;
+    }
+    // Apply the fixes of all issues without asking. Fixes that overlap an
+    // earlier fix are skipped, or if deferConflicts is set, left for
+    // review afterwards.
+    void applyAll(bool deferConflicts);
     void saveConfig();
     void readConfig();
     void setIgnores(std::set<std::string> const& ignores);
+    // Read rules for deciding about issues without asking
+    void readRules(utils::path const& fileName);
+    void setJournal(Journal* journal) { replacer.setJournal(journal); }
+    void setMemoryBudget(size_t bytes) { replacer.setMemoryBudget(bytes); }
 };
@@ -0,0 +1,53 @@
+#include "catch.hpp"
+#include "autotidy.h"
+#include "path.h"
+#include "utils.h"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <string>
+
+TEST_CASE("apply_all_undo", "")
+{
+    // Two fixes of the same text, so the second one conflicts and its
+    // issue is reviewed after the batch
+    auto source = (currentDir() / "applyall.cpp").string();
+    std::string original = "int* a = NULL;\nint* b = NULL;\n";
+    writeFile(source, original);
+    writeFile("applyall.log",
+              fmt::format("{0}:1:10: warning: use nullptr [a-check]\n"
+                          "{0}:1:10: warning: use nullptr [b-check]\n"
+                          "{0}:2:10: warning: use nullptr [a-check]\n",
+                          source));
+    auto fix = [&](char const* check, int offset) {
+        return fmt::format("  - DiagnosticName: {}\n"
+                           "    Replacements:\n"
+                           "      - FilePath: {}\n"
+                           "        Offset: {}\n"
+                           "        Length: 4\n"
+                           "        ReplacementText: 'nullptr'\n",
+                           check, source, offset);
+    };
+    writeFile("applyall.yaml", "---\nMainSourceFile: " + source +
+                                   "\nDiagnostics:\n" + fix("a-check", 9) +
+                                   fix("b-check", 9) + fix("a-check", 24) +
+                                   "...\n");
+    writeFile("applyall.keys", "u");
+
+    {
+        AutoTidy tidy{"applyall.log", "applyall.clang-tidy",
+                      "diff -u {0} {1}", "applyall.yaml"};
+        REQUIRE(tidy.replayKeys("applyall.keys"));
+        // Undo in the review of the conflicting issue reverts the batch
+        tidy.applyAll(true);
+    }
+    auto contents = readFile(source);
+    REQUIRE(std::string(contents.begin(), contents.end()) == original);
+
+    for (auto const* f : {"applyall.log", "applyall.yaml", "applyall.keys",
+                          "applyall.clang-tidy", ".autotidy/session"}) {
+        std::remove(f);
+    }
+    std::remove(source.c_str());
+}
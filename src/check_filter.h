@@ -0,0 +1,129 @@
+#pragma once
+
+#include "check_registry.h"
+#include "glob.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The 'Checks' option of .clang-tidy; a comma separated list of globs,
+// where a leading '-' disables the matching checks. Like in clang-tidy,
+// the last glob that matches a check decides, and a check that no glob
+// matches is disabled.
+//
+// Check names are interned, and the verdict for each is remembered until
+// the globs change. Known checks keep their id from the check registry, so
+// they have the same id in every filter; other checks are numbered after
+// them.
+class CheckFilter
+{
+    std::vector<std::string> patterns_;
+    std::vector<std::pair<Glob, bool>> globs_;
+
+    // Checks that are not in the registry
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<std::string> names_;
+    // Per check id; -1 if not known yet, else 0 or 1
+    mutable std::vector<int8_t> verdicts_;
+
+    static std::string trim(std::string const& text)
+    {
+        auto first = text.find_first_not_of(" \t\n");
+        if (first == std::string::npos) {
+            return "";
+        }
+        auto last = text.find_last_not_of(" \t\n");
+        return text.substr(first, last - first + 1);
+    }
+
+public:
+    CheckFilter() { setChecks("*"); }
+
+    void setChecks(std::string const& checks)
+    {
+        patterns_.clear();
+        globs_.clear();
+        size_t start = 0;
+        while (start <= checks.size()) {
+            auto end = checks.find(',', start);
+            if (end == std::string::npos) {
+                end = checks.size();
+            }
+            add(checks.substr(start, end - start));
+            start = end + 1;
+        }
+        verdicts_.assign(checkCount + names_.size(), -1);
+    }
+
+    // Add a glob last in the list, so it overrides the earlier ones
+    void add(std::string const& pattern)
+    {
+        auto glob = trim(pattern);
+        if (glob.empty()) {
+            return;
+        }
+        patterns_.push_back(glob);
+        bool enable = glob.front() != '-';
+        globs_.emplace_back(Glob{enable ? glob : glob.substr(1)}, enable);
+        verdicts_.assign(checkCount + names_.size(), -1);
+    }
+
+    // The list of globs, as written in .clang-tidy
+    std::vector<std::string> const& patterns() const { return patterns_; }
+
+    uint32_t intern(std::string const& check)
+    {
+        auto known = findCheck(check);
+        if (known != UnknownCheck) {
+            return known;
+        }
+        auto it = ids_.find(check);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        auto id = static_cast<uint32_t>(checkCount + names_.size());
+        ids_.emplace(check, id);
+        names_.push_back(check);
+        verdicts_.push_back(-1);
+        return id;
+    }
+
+    std::string name(uint32_t id) const
+    {
+        return id < checkCount ? checkInfos[id].name
+                               : names_[id - checkCount];
+    }
+
+    bool enabled(uint32_t id) const
+    {
+        auto& verdict = verdicts_[id];
+        if (verdict < 0) {
+            verdict = 0;
+            auto check = name(id);
+            for (auto it = globs_.rbegin(); it != globs_.rend(); ++it) {
+                if (it->first.match(check)) {
+                    verdict = it->second ? 1 : 0;
+                    break;
+                }
+            }
+        }
+        return verdict == 1;
+    }
+
+    bool enabled(std::string const& check) { return enabled(intern(check)); }
+
+    // If the issues of a check should be hidden. Compiler diagnostics,
+    // like 'clang-diagnostic-unused-variable' or '-Wshadow', come from the
+    // compile flags rather than from the checks, so they are never hidden.
+    bool hides(std::string const& check)
+    {
+        if (check.compare(0, 17, "clang-diagnostic-") == 0 ||
+            check.compare(0, 2, "-W") == 0) {
+            return false;
+        }
+        return !enabled(check);
+    }
+};
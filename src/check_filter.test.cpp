@@ -0,0 +1,28 @@
+#include "catch.hpp"
+#include "check_filter.h"
+
+TEST_CASE("check_filter", "")
+{
+    CheckFilter filter;
+    REQUIRE(filter.enabled("anything"));
+
+    filter.setChecks("-*, modernize-*,-modernize-use-auto, google-*");
+    REQUIRE(filter.enabled("modernize-use-nullptr"));
+    REQUIRE(!filter.enabled("modernize-use-auto"));
+    REQUIRE(filter.enabled("google-runtime-int"));
+    REQUIRE(!filter.enabled("readability-magic-numbers"));
+
+    // Later globs override earlier ones, and verdicts are recomputed
+    auto id = filter.intern("google-runtime-int");
+    filter.add("-google-runtime-*");
+    REQUIRE(!filter.enabled(id));
+    REQUIRE(filter.patterns().size() == 5);
+
+    // Compiler diagnostics are shown even when no glob enables them
+    REQUIRE(filter.hides("readability-magic-numbers"));
+    REQUIRE(!filter.hides("modernize-use-nullptr"));
+    REQUIRE(!filter.hides("clang-diagnostic-unused-variable"));
+    REQUIRE(!filter.hides("clang-diagnostic-error"));
+    REQUIRE(!filter.hides("-Wshadow"));
+    REQUIRE(filter.hides("clang-analyzer-core.NullDereference"));
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// All checks that have documentation, generated by makedoc. A check is
+// found by its name through a minimal perfect hash, and its position in
+// the table is its id, so the ids of known checks are 0 to checkCount - 1.
+//
+// The names are hashed into buckets, and each bucket has a seed that
+// hashes its names into free slots of the table (hash and displace).
+
+struct CheckInfo
+{
+    char const* name;
+    // Like 'modernize' or 'clang-analyzer'
+    char const* category;
+    // Position in docIndex
+    uint16_t doc;
+};
+
+// Generated by makedoc, in manpages.cpp
+extern const CheckInfo checkInfos[];
+extern const size_t checkCount;
+extern const uint16_t checkSeeds[];
+extern const size_t checkSeedCount;
+
+constexpr uint32_t UnknownCheck = 0xffffffff;
+
+constexpr uint32_t checkHash(char const* name, size_t size, uint32_t seed)
+{
+    uint32_t hash = 2166136261U ^ (seed * 16777619U);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619U;
+    }
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6dU;
+    return hash ^ (hash >> 12);
+}
+
+// The slot of a name in a table of count names, given the seeds of the
+// buckets
+constexpr uint32_t checkSlot(char const* name, size_t size,
+                             uint16_t const* seeds, size_t seedCount,
+                             size_t count)
+{
+    return checkHash(name, size,
+                     seeds[checkHash(name, size, 0) % seedCount]) %
+           count;
+}
+
+// Find the seeds of a minimal perfect hash of the names, which must be
+// distinct. Returns an empty list if there is none.
+inline std::vector<uint16_t>
+perfectHashSeeds(std::vector<std::string> const& names)
+{
+    auto count = names.size();
+    auto bucketCount = std::max<size_t>(1, (count + 3) / 4);
+    std::vector<std::vector<size_t>> buckets(bucketCount);
+    for (size_t i = 0; i < count; i++) {
+        auto const& n = names[i];
+        buckets[checkHash(n.data(), n.size(), 0) % bucketCount].push_back(i);
+    }
+    // Place the largest buckets first, while most slots are free
+    std::vector<size_t> order(bucketCount);
+    for (size_t b = 0; b < bucketCount; b++) {
+        order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint16_t> seeds(bucketCount);
+    std::vector<bool> used(count);
+    std::vector<size_t> slots;
+    for (auto b : order) {
+        if (buckets[b].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t seed = 1; seed <= 0xffff && !placed; seed++) {
+            slots.clear();
+            for (auto i : buckets[b]) {
+                auto const& n = names[i];
+                auto slot = checkHash(n.data(), n.size(), seed) % count;
+                if (used[slot] ||
+                    std::find(slots.begin(), slots.end(), slot) !=
+                        slots.end()) {
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (slots.size() == buckets[b].size()) {
+                for (auto slot : slots) {
+                    used[slot] = true;
+                }
+                seeds[b] = static_cast<uint16_t>(seed);
+                placed = true;
+            }
+        }
+        if (!placed) {
+            return {};
+        }
+    }
+    return seeds;
+}
+
+// The category of a check, from its name. Checks of clang itself have two
+// part categories, like 'clang-analyzer'.
+inline std::string checkCategory(std::string const& name)
+{
+    auto dash = name.find('-');
+    if (dash != std::string::npos && name.compare(0, dash, "clang") == 0) {
+        dash = name.find('-', dash + 1);
+    }
+    return name.substr(0, dash);
+}
+
+// The id of a known check, or UnknownCheck for checks without
+// documentation, like those of a newer clang-tidy
+inline uint32_t findCheck(std::string const& name)
+{
+    if (checkCount == 0) {
+        return UnknownCheck;
+    }
+    auto id = checkSlot(name.data(), name.size(), checkSeeds, checkSeedCount,
+                        checkCount);
+    return name == checkInfos[id].name ? id : UnknownCheck;
+}
+
+// The known check of a name, or nullptr
+inline CheckInfo const* checkInfo(std::string const& name)
+{
+    auto id = findCheck(name);
+    return id == UnknownCheck ? nullptr : &checkInfos[id];
+}
@@ -0,0 +1,55 @@
+#include "catch.hpp"
+#include "check_filter.h"
+#include "check_registry.h"
+#include "doc_blob.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+TEST_CASE("check_registry", "")
+{
+    std::vector<std::string> names{"a-one", "a-two", "b-three", "c-four",
+                                   "c-five", "c-six", "d-seven"};
+    auto seeds = perfectHashSeeds(names);
+    REQUIRE(!seeds.empty());
+    std::set<uint32_t> slots;
+    for (auto const& n : names) {
+        slots.insert(checkSlot(n.data(), n.size(), seeds.data(),
+                               seeds.size(), names.size()));
+    }
+    REQUIRE(slots.size() == names.size());
+    REQUIRE(*slots.rbegin() == names.size() - 1);
+
+    REQUIRE(checkCategory("modernize-use-nullptr") == "modernize");
+    REQUIRE(checkCategory("clang-analyzer-core.NullDereference") ==
+            "clang-analyzer");
+    REQUIRE(checkCategory("nodash") == "nodash");
+
+    // The generated registry
+    auto id = findCheck("modernize-use-nullptr");
+    REQUIRE(id < checkCount);
+    REQUIRE(checkInfos[id].category == "modernize"s);
+    REQUIRE(docIndex[checkInfos[id].doc].name == "modernize-use-nullptr"s);
+    // Every documented check is found, aliases under their own name
+    for (auto const* name :
+         {"modernize-use-override", "readability-braces-around-statements",
+          "llvm-namespace-comment", "performance-move-const-arg",
+          "hicpp-use-equals-default", "cert-err61-cpp"}) {
+        auto const* info = checkInfo(name);
+        REQUIRE(info != nullptr);
+        REQUIRE(info->name == std::string(name));
+        REQUIRE(info->category == checkCategory(name));
+        REQUIRE(docIndex[info->doc].name == std::string(name));
+    }
+    REQUIRE(findCheck("modernize-use-something-new") == UnknownCheck);
+    REQUIRE(checkInfo("") == nullptr);
+
+    CheckFilter filter;
+    REQUIRE(filter.intern("modernize-use-nullptr") == id);
+    REQUIRE(filter.intern("modernize-use-something-new") == checkCount);
+    REQUIRE(filter.enabled(checkCount));
+}
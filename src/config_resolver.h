@@ -0,0 +1,141 @@
+#pragma once
+
+#include "check_filter.h"
+#include "utils.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+// Finds the Checks that apply in each directory, from the closest
+// .clang-tidy in it or its parents. A .clang-tidy with
+// 'InheritParentConfig: true' adds its checks after the ones of its
+// parent directory. Directories with no .clang-tidy above them, and ones
+// whose .clang-tidy has no Checks and does not inherit, use the checks
+// set with setDefaultChecks(), which are the ones of the -c config. This
+// differs from clang-tidy, which falls back to its built-in defaults.
+//
+// Each .clang-tidy is parsed once, and again only if its modification
+// time (in nanoseconds, where the file system has them) or size changes.
+// The checks of each directory are cached, and directories with the same
+// checks share one CheckFilter.
+class ConfigResolver
+{
+    struct ConfigFile
+    {
+        bool exists = false;
+        int64_t mtime = 0;
+        int64_t size = 0;
+        std::string checks;
+        bool hasChecks = false;
+        bool inherit = false;
+    };
+
+    std::string defaultChecks_ = "*";
+    std::map<std::string, ConfigFile> files_;
+    std::unordered_map<std::string, std::string> dirChecks_;
+    std::unordered_map<std::string, CheckFilter*> dirFilters_;
+    std::map<std::string, CheckFilter> filters_;
+
+    static std::string parentDir(std::string const& dir)
+    {
+        auto slash = dir.find_last_of('/');
+        if (slash == std::string::npos || dir == "/") {
+            return "";
+        }
+        return slash == 0 ? "/" : dir.substr(0, slash);
+    }
+
+    ConfigFile const& configFile(std::string const& dir)
+    {
+        auto name = dir == "/" ? "/.clang-tidy" : dir + "/.clang-tidy";
+        struct stat sb; // NOLINT
+        bool exists = stat(name.c_str(), &sb) >= 0;
+        auto mtime = exists ? modificationTime(sb) : 0;
+        auto size = exists ? static_cast<int64_t>(sb.st_size) : 0;
+        auto& file = files_[name];
+        if (file.exists == exists && file.mtime == mtime &&
+            file.size == size) {
+            return file;
+        }
+        file = ConfigFile{};
+        file.exists = exists;
+        file.mtime = mtime;
+        file.size = size;
+        if (!exists) {
+            return file;
+        }
+        try {
+            auto config = YAML::LoadFile(name);
+            if (config["Checks"]) {
+                file.checks = config["Checks"].as<std::string>();
+                file.hasChecks = true;
+            }
+            if (config["InheritParentConfig"]) {
+                file.inherit = config["InheritParentConfig"].as<bool>();
+            }
+        } catch (YAML::Exception&) {
+            // Like a missing file, so the parent config is used
+            file.exists = false;
+        }
+        return file;
+    }
+
+    std::string const& checksFor(std::string const& dir)
+    {
+        auto it = dirChecks_.find(dir);
+        if (it != dirChecks_.end()) {
+            return it->second;
+        }
+        auto parent = parentDir(dir);
+        auto const& file = configFile(dir);
+        std::string checks;
+        if (!file.exists) {
+            checks = parent.empty() ? defaultChecks_ : checksFor(parent);
+        } else if (file.inherit && !parent.empty()) {
+            checks = checksFor(parent) + "," + file.checks;
+        } else if (!file.hasChecks) {
+            checks = defaultChecks_;
+        } else {
+            checks = file.checks;
+        }
+        return dirChecks_[dir] = checks;
+    }
+
+public:
+    // Checks used when no .clang-tidy is found
+    void setDefaultChecks(std::string const& checks)
+    {
+        defaultChecks_ = checks;
+        invalidate();
+    }
+
+    // Forget the checks of all directories, so they are looked up again.
+    // Only config files that changed are parsed again.
+    void invalidate()
+    {
+        dirChecks_.clear();
+        dirFilters_.clear();
+    }
+
+    // The filter for files in an absolute directory
+    CheckFilter& filterFor(std::string const& dir)
+    {
+        auto it = dirFilters_.find(dir);
+        if (it != dirFilters_.end()) {
+            return *it->second;
+        }
+        auto const& checks = checksFor(dir);
+        auto filter = filters_.find(checks);
+        if (filter == filters_.end()) {
+            filter = filters_.emplace(checks, CheckFilter{}).first;
+            filter->second.setChecks(checks);
+        }
+        dirFilters_[dir] = &filter->second;
+        return filter->second;
+    }
+};
@@ -0,0 +1,41 @@
+#include "catch.hpp"
+#include "config_resolver.h"
+#include "path.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <string>
+
+TEST_CASE("config_resolver", "")
+{
+    utils::create_directories("cfgtest/sub/inner");
+    utils::create_directories("cfgtest/own");
+    auto root = currentDir().string() + "/cfgtest";
+    writeFile(root + "/.clang-tidy", "Checks: '-*,modernize-*'\n");
+    writeFile(root + "/sub/.clang-tidy",
+              "Checks: '-modernize-use-auto'\nInheritParentConfig: true\n");
+    writeFile(root + "/own/.clang-tidy", "Checks: '-*,google-*'\n");
+
+    ConfigResolver configs;
+    REQUIRE(configs.filterFor(root).enabled("modernize-use-auto"));
+    auto& inner = configs.filterFor(root + "/sub/inner");
+    REQUIRE(!inner.enabled("modernize-use-auto"));
+    REQUIRE(inner.enabled("modernize-use-nullptr"));
+    REQUIRE(!configs.filterFor(root + "/own").enabled("modernize-use-auto"));
+
+    // Rewritten within the same second, with the same size
+    writeFile(root + "/own/.clang-tidy", "Checks: '-*,moder*-*'\n");
+    configs.invalidate();
+    REQUIRE(configs.filterFor(root + "/own").enabled("modernize-use-auto"));
+
+    // Without Checks, the default checks are used instead of none
+    writeFile(root + "/own/.clang-tidy", "HeaderFilterRegex: '.*'\n");
+    configs.setDefaultChecks("-*,google-*");
+    REQUIRE(configs.filterFor(root + "/own").enabled("google-runtime-int"));
+    REQUIRE(!configs.filterFor(root + "/own").enabled("modernize-use-auto"));
+
+    for (auto const* f : {"/sub/.clang-tidy", "/own/.clang-tidy",
+                          "/.clang-tidy", "/sub/inner", "/sub", "/own", ""}) {
+        std::remove((root + f).c_str());
+    }
+}
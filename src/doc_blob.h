@@ -0,0 +1,188 @@
+#pragma once
+
+#include "check_registry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The man pages of all checks are stored compressed, each page on its own,
+// with an index sorted by check name. Text that is common to many pages is
+// kept once, in a dictionary that the pages refer to. Only the page that is
+// asked for is looked up and decompressed, and nothing is done at startup.
+//
+// The compression is a simple LZ77 variant. The data is a list of tokens:
+// - A tag below 0x80 is followed by tag + 1 literal bytes.
+// - A tag of 0x80 or higher copies (tag & 0x7f) + 4 bytes from earlier
+//   output. The 16 bit little endian distance back follows the tag.
+
+struct DocEntry
+{
+    char const* name;
+    uint32_t offset;
+    uint32_t packedSize;
+    uint32_t size;
+};
+
+// Generated by makedoc, in manpages.cpp. The data starts with a
+// dictionary that all pages are compressed with, and ends with the search
+// index (see doc_search.h).
+extern const DocEntry docIndex[];
+extern const size_t docCount;
+extern const size_t docDictionarySize;
+extern const size_t docSearchOffset;
+extern const unsigned char docData[];
+
+// Compress data, with matches found in the dictionary as well. The same
+// dictionary must be given when decompressing.
+inline std::string lzCompress(std::string const& data,
+                              std::string const& dictionary = "")
+{
+    constexpr size_t MinMatch = 4;
+    constexpr size_t MaxMatch = 0x7f + MinMatch;
+    constexpr size_t MaxLiterals = 0x80;
+    constexpr size_t Window = 0xffff;
+    constexpr int HashBits = 15;
+    constexpr int MaxTries = 64;
+
+    auto text = dictionary + data;
+    std::string out;
+    // Latest position of each hash, and the position before it with the
+    // same hash
+    std::vector<int64_t> head(size_t{1} << HashBits, -1);
+    std::vector<int64_t> chain(text.size(), -1);
+    auto hash = [&](size_t pos) {
+        uint32_t v = 0;
+        std::memcpy(&v, &text[pos], 4);
+        return (v * 2654435761U) >> (32 - HashBits);
+    };
+    // Positions below this are in the hash chains
+    size_t inserted = 0;
+    auto insertUpTo = [&](size_t end) {
+        for (; inserted < end && inserted + MinMatch <= text.size();
+             inserted++) {
+            auto h = hash(inserted);
+            chain[inserted] = head[h];
+            head[h] = static_cast<int64_t>(inserted);
+        }
+    };
+    // Longest earlier match at pos, as (length, distance)
+    auto longest = [&](size_t pos) {
+        size_t best = 0;
+        size_t distance = 0;
+        auto limit = std::min(MaxMatch, text.size() - pos);
+        auto candidate = head[hash(pos)];
+        for (int tries = 0; tries < MaxTries && candidate >= 0 &&
+                            pos - static_cast<size_t>(candidate) <= Window;
+             tries++) {
+            auto from = static_cast<size_t>(candidate);
+            size_t length = 0;
+            while (length < limit &&
+                   text[from + length] == text[pos + length]) {
+                length++;
+            }
+            if (length > best) {
+                best = length;
+                distance = pos - from;
+            }
+            candidate = chain[from];
+        }
+        return std::make_pair(best, distance);
+    };
+
+    size_t literalStart = dictionary.size();
+    auto flushLiterals = [&](size_t end) {
+        while (literalStart < end) {
+            auto n = std::min(end - literalStart, MaxLiterals);
+            out += static_cast<char>(n - 1);
+            out.append(text, literalStart, n);
+            literalStart += n;
+        }
+    };
+
+    size_t pos = dictionary.size();
+    while (pos + MinMatch <= text.size()) {
+        insertUpTo(pos);
+        auto match = longest(pos);
+        if (match.first < MinMatch) {
+            pos++;
+            continue;
+        }
+        // Leave a literal if the match at the next byte is longer
+        if (pos + 1 + MinMatch <= text.size()) {
+            insertUpTo(pos + 1);
+            auto next = longest(pos + 1);
+            if (next.first > match.first) {
+                pos++;
+                match = next;
+            }
+        }
+        flushLiterals(pos);
+        out += static_cast<char>(0x80 | (match.first - MinMatch));
+        out += static_cast<char>(match.second & 0xff);
+        out += static_cast<char>(match.second >> 8);
+        pos += match.first;
+        literalStart = pos;
+    }
+    flushLiterals(text.size());
+    return out;
+}
+
+inline std::string lzDecompress(unsigned char const* data, size_t size,
+                                size_t outSize,
+                                std::string const& dictionary = "")
+{
+    auto out = dictionary;
+    out.reserve(dictionary.size() + outSize);
+    size_t pos = 0;
+    while (pos < size) {
+        auto tag = data[pos++];
+        if (tag < 0x80) {
+            size_t n = std::min<size_t>(tag + 1, size - pos);
+            out.append(reinterpret_cast<char const*>(data + pos), n);
+            pos += n;
+            continue;
+        }
+        if (pos + 2 > size) {
+            break;
+        }
+        size_t length = (tag & 0x7f) + 4;
+        size_t distance = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+        if (distance == 0 || distance > out.size()) {
+            break;
+        }
+        // Byte by byte, since the copy may overlap what it writes
+        auto from = out.size() - distance;
+        for (size_t i = 0; i < length; i++) {
+            out += out[from + i];
+        }
+    }
+    return out.substr(dictionary.size());
+}
+
+// The man page of a check, or an empty string if there is none. Checks are
+// found through the check registry, other pages by searching the index.
+inline std::string docPage(std::string const& name)
+{
+    auto const* end = docIndex + docCount;
+    auto const* it = end;
+    if (auto const* info = checkInfo(name)) {
+        it = docIndex + info->doc;
+    } else {
+        it = std::lower_bound(docIndex, end, name,
+                              [](DocEntry const& e, std::string const& n) {
+                                  return std::strcmp(e.name, n.c_str()) < 0;
+                              });
+    }
+    if (it == end || name != it->name) {
+        return "";
+    }
+    std::string dictionary(reinterpret_cast<char const*>(docData),
+                           docDictionarySize);
+    return lzDecompress(docData + it->offset, it->packedSize, it->size,
+                        dictionary);
+}
@@ -0,0 +1,24 @@
+#include "catch.hpp"
+#include "doc_blob.h"
+
+#include <string>
+
+TEST_CASE("doc_blob", "")
+{
+    std::string dictionary = ".SH NAME\n.SH DESCRIPTION\n";
+    std::string page = ".SH NAME\nmodernize-use-nullptr\n.SH DESCRIPTION\n"
+                       "Use nullptr. Use nullptr. Use nullptr.\naaaaaaaaaaaa";
+    auto packed = lzCompress(page, dictionary);
+    REQUIRE(packed.size() < page.size());
+    auto const* data = reinterpret_cast<unsigned char const*>(packed.data());
+    REQUIRE(lzDecompress(data, packed.size(), page.size(), dictionary) ==
+            page);
+
+    std::string empty;
+    REQUIRE(lzDecompress(nullptr, 0, 0).empty());
+    REQUIRE(lzCompress(empty).empty());
+    std::string shortText = "abc";
+    packed = lzCompress(shortText);
+    data = reinterpret_cast<unsigned char const*>(packed.data());
+    REQUIRE(lzDecompress(data, packed.size(), 3) == shortText);
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "doc_blob.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Full-text search over the check docs. makedoc builds an inverted index
+// from every word to the pages that have it, and it is stored with the
+// pages. Searches only look at the index, and rank the pages with BM25.
+//
+// The index is a list of numbers; 32 bit little endian ones for the
+// tables, and varints for the postings:
+// - the number of terms and of pages
+// - the number of words in each page
+// - for each term, in sorted order, where its text and postings start,
+//   followed by one more entry marking the end of both
+// - the text of the terms, one after the other
+// - the postings of each term; the page as a delta from the previous
+//   one, and the number of times the term is in it
+
+// The words of a text, in lower case, without the most common English
+// words. Names like 'modernize-use-nullptr' are split into their parts.
+inline std::vector<std::string> searchTerms(std::string const& text)
+{
+    static char const* const stopWords[] = {
+        "an", "and", "are", "as",   "be",  "by",   "can",  "for",
+        "if", "in",  "is",  "it",   "not", "of",   "on",   "or",
+        "that", "the", "this", "to", "which", "will", "with"};
+    std::vector<std::string> terms;
+    std::string term;
+    auto finish = [&] {
+        if (term.size() >= 2 &&
+            std::none_of(std::begin(stopWords), std::end(stopWords),
+                         [&](char const* w) { return term == w; })) {
+            terms.push_back(term);
+        }
+        term.clear();
+    };
+    for (auto c : text) {
+        auto u = static_cast<unsigned char>(c);
+        if (std::isalnum(u) != 0 || c == '_') {
+            term += static_cast<char>(std::tolower(u));
+        } else {
+            finish();
+        }
+    }
+    finish();
+    return terms;
+}
+
+// The text of a man page without roff requests and escapes
+inline std::string plainText(std::string const& page)
+{
+    std::string text;
+    std::istringstream in{page};
+    std::string line;
+    bool inMacro = false;
+    while (std::getline(in, line)) {
+        if (inMacro) {
+            inMacro = line != "..";
+            continue;
+        }
+        if (!line.empty() && (line[0] == '.' || line[0] == '\'')) {
+            inMacro = line.compare(1, 2, "de") == 0 ||
+                      line.compare(1, 2, "ig") == 0;
+            // Text given to font requests is part of the page
+            if (line.compare(0, 3, ".B ") != 0 &&
+                line.compare(0, 3, ".I ") != 0) {
+                continue;
+            }
+            line = line.substr(3);
+        }
+        for (size_t i = 0; i < line.size(); i++) {
+            if (line[i] != '\\' || i + 1 >= line.size()) {
+                text += line[i];
+                continue;
+            }
+            auto e = line[++i];
+            if (e == 'f') {
+                i += i + 1 < line.size() && line[i + 1] == '(' ? 3 : 1;
+            } else if (e == '(') {
+                i += 2;
+                text += ' ';
+            } else if (e == '-' || e == 'e') {
+                text += e == '-' ? '-' : '\\';
+            } else if (e != '&' && e != '|' && e != '^' && e != 'c') {
+                text += e;
+            }
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+namespace detail {
+
+inline void putU32(std::string& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        out += static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+}
+
+inline uint32_t getU32(unsigned char const* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline void putVarint(std::string& out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+inline uint32_t getVarint(unsigned char const*& p)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        auto b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (b < 0x80) {
+            break;
+        }
+    }
+    return v;
+}
+
+} // namespace detail
+
+// Build the index of the pages, given as pairs of check name and man
+// page. Words of the check name count more than words in its text.
+inline std::string
+buildSearchIndex(std::vector<std::pair<std::string, std::string>> const& pages)
+{
+    constexpr uint32_t NameWeight = 5;
+
+    // Postings of each term, as (page, count)
+    std::map<std::string, std::vector<std::pair<uint32_t, uint32_t>>> terms;
+    std::vector<uint32_t> lengths;
+    for (uint32_t doc = 0; doc < pages.size(); doc++) {
+        std::map<std::string, uint32_t> counts;
+        for (auto const& t : searchTerms(pages[doc].first)) {
+            counts[t] += NameWeight;
+        }
+        auto words = searchTerms(plainText(pages[doc].second));
+        for (auto const& t : words) {
+            counts[t]++;
+        }
+        lengths.push_back(static_cast<uint32_t>(words.size()));
+        for (auto const& c : counts) {
+            terms[c.first].emplace_back(doc, c.second);
+        }
+    }
+
+    std::string text;
+    std::string postings;
+    std::vector<std::pair<uint32_t, uint32_t>> starts;
+    for (auto const& t : terms) {
+        starts.emplace_back(text.size(), postings.size());
+        text += t.first;
+        uint32_t last = 0;
+        for (auto const& p : t.second) {
+            detail::putVarint(postings, p.first - last);
+            detail::putVarint(postings, p.second);
+            last = p.first;
+        }
+    }
+    starts.emplace_back(text.size(), postings.size());
+
+    std::string index;
+    detail::putU32(index, static_cast<uint32_t>(terms.size()));
+    detail::putU32(index, static_cast<uint32_t>(pages.size()));
+    for (auto l : lengths) {
+        detail::putU32(index, l);
+    }
+    for (auto const& s : starts) {
+        detail::putU32(index, s.first);
+        detail::putU32(index, s.second);
+    }
+    return index + text + postings;
+}
+
+// Searches an index made by buildSearchIndex()
+class DocSearch
+{
+    unsigned char const* data_;
+    uint32_t termCount_ = 0;
+    uint32_t docCount_ = 0;
+    unsigned char const* lengths_ = nullptr;
+    unsigned char const* starts_ = nullptr;
+    unsigned char const* text_ = nullptr;
+    unsigned char const* postings_ = nullptr;
+    double averageLength_ = 1;
+
+    uint32_t textStart(uint32_t term) const
+    {
+        return detail::getU32(starts_ + term * 8);
+    }
+    uint32_t postingsStart(uint32_t term) const
+    {
+        return detail::getU32(starts_ + term * 8 + 4);
+    }
+
+    std::string term(uint32_t t) const
+    {
+        return {reinterpret_cast<char const*>(text_) + textStart(t),
+                textStart(t + 1) - textStart(t)};
+    }
+
+public:
+    explicit DocSearch(unsigned char const* data) : data_(data)
+    {
+        termCount_ = detail::getU32(data_);
+        docCount_ = detail::getU32(data_ + 4);
+        lengths_ = data_ + 8;
+        starts_ = lengths_ + docCount_ * 4;
+        text_ = starts_ + (termCount_ + 1) * 8;
+        postings_ = text_ + textStart(termCount_);
+        double total = 0;
+        for (uint32_t d = 0; d < docCount_; d++) {
+            total += detail::getU32(lengths_ + d * 4);
+        }
+        averageLength_ = docCount_ > 0 ? std::max(total / docCount_, 1.0) : 1;
+    }
+
+    // Pages that have the words of the query, best match first, as pairs
+    // of page number and score. Words of three letters or more also match
+    // the words they are the start of.
+    std::vector<std::pair<uint32_t, double>> search(std::string const& query,
+                                                    size_t limit) const
+    {
+        constexpr double K1 = 1.2;
+        constexpr double B = 0.75;
+
+        std::vector<double> scores(docCount_);
+        for (auto const& word : searchTerms(query)) {
+            // First term that is not less than the word
+            uint32_t lo = 0;
+            uint32_t hi = termCount_;
+            while (lo < hi) {
+                auto mid = lo + (hi - lo) / 2;
+                if (term(mid) < word) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            for (auto t = lo; t < termCount_; t++) {
+                auto name = term(t);
+                if (name.compare(0, word.size(), word) != 0 ||
+                    (word.size() < 3 && name != word)) {
+                    break;
+                }
+                auto const* p = postings_ + postingsStart(t);
+                auto const* end = postings_ + postingsStart(t + 1);
+                std::vector<std::pair<uint32_t, uint32_t>> docs;
+                uint32_t doc = 0;
+                while (p < end) {
+                    doc += detail::getVarint(p);
+                    docs.emplace_back(doc, detail::getVarint(p));
+                }
+                auto n = static_cast<double>(docs.size());
+                auto idf = std::log(1 + (docCount_ - n + 0.5) / (n + 0.5));
+                for (auto const& d : docs) {
+                    auto tf = static_cast<double>(d.second);
+                    auto length = detail::getU32(lengths_ + d.first * 4);
+                    scores[d.first] +=
+                        idf * tf * (K1 + 1) /
+                        (tf + K1 * (1 - B + B * length / averageLength_));
+                }
+            }
+        }
+
+        std::vector<std::pair<uint32_t, double>> results;
+        for (uint32_t d = 0; d < docCount_; d++) {
+            if (scores[d] > 0) {
+                results.emplace_back(d, scores[d]);
+            }
+        }
+        std::stable_sort(results.begin(), results.end(),
+                         [](auto const& a, auto const& b) {
+                             return a.second > b.second;
+                         });
+        if (results.size() > limit) {
+            results.resize(limit);
+        }
+        return results;
+    }
+};
+
+struct DocMatch
+{
+    std::string name;
+    double score;
+};
+
+// Search the docs of all checks, in the index made by makedoc
+inline std::vector<DocMatch> searchDocs(std::string const& query,
+                                        size_t limit = 20)
+{
+    static const DocSearch search{docData + docSearchOffset};
+    std::vector<DocMatch> matches;
+    for (auto const& r : search.search(query, limit)) {
+        if (r.first < docCount) {
+            matches.push_back({docIndex[r.first].name, r.second});
+        }
+    }
+    return matches;
+}
+
+// The first line of a text that has a word of the query, to show with a
+// search result
+inline std::string matchingLine(std::string const& text,
+                                std::string const& query)
+{
+    auto words = searchTerms(query);
+    std::istringstream in{text};
+    std::string line;
+    while (std::getline(in, line)) {
+        for (auto const& t : searchTerms(line)) {
+            for (auto const& w : words) {
+                if (t == w ||
+                    (w.size() >= 3 && t.compare(0, w.size(), w) == 0)) {
+                    auto start = line.find_first_not_of(' ');
+                    return start == std::string::npos ? line
+                                                      : line.substr(start);
+                }
+            }
+        }
+    }
+    return "";
+}
@@ -0,0 +1,37 @@
+#include "catch.hpp"
+#include "doc_search.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("doc_search", "")
+{
+    REQUIRE(searchTerms("Use the NULL macro, in modernize-use-nullptr") ==
+            std::vector<std::string>{"use", "null", "macro", "modernize",
+                                     "use", "nullptr"});
+    REQUIRE(plainText(".TH X\n.B bold\nUse \\fBnullptr\\fP\\-ok\n") ==
+            "bold\nUse nullptr-ok\n");
+
+    std::vector<std::pair<std::string, std::string>> pages{
+        {"bugprone-widening-cast", "Finds casts that widen a result.\n"},
+        {"modernize-use-nullptr", "Use nullptr instead of NULL or 0.\n"},
+        {"readability-casting", "Casting casting casting, and nullptr.\n"}};
+    auto index = buildSearchIndex(pages);
+    DocSearch search{reinterpret_cast<unsigned char const*>(index.data())};
+
+    auto results = search.search("nullptr", 10);
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[0].first == 1);
+    REQUIRE(results[1].first == 2);
+
+    // Words of three letters or more match the start of longer words
+    REQUIRE(search.search("cast", 10).size() == 2);
+    REQUIRE(search.search("wide", 10)[0].first == 0);
+    REQUIRE(search.search("nu", 10).empty());
+    REQUIRE(search.search("missing", 10).empty());
+    REQUIRE(search.search("nullptr cast", 1).size() == 1);
+
+    REQUIRE(matchingLine("first\n  second nullptr\n", "NULLPTR") ==
+            "second nullptr");
+}
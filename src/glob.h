@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A glob pattern, split up once so it can be matched against many names.
+// '*' matches any number of characters, including '/', and '?' matches
+// any one character.
+class Glob
+{
+    // The literal parts between the '*'s
+    std::vector<std::string> parts_;
+
+    static bool matchPart(char const* text, std::string const& part)
+    {
+        for (size_t i = 0; i < part.size(); i++) {
+            if (part[i] != '?' && part[i] != text[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit Glob(std::string const& pattern)
+    {
+        size_t start = 0;
+        size_t star = 0;
+        while ((star = pattern.find('*', start)) != std::string::npos) {
+            parts_.push_back(pattern.substr(start, star - start));
+            start = star + 1;
+        }
+        parts_.push_back(pattern.substr(start));
+    }
+
+    bool match(std::string const& text) const
+    {
+        auto const& first = parts_.front();
+        if (parts_.size() == 1) {
+            return text.size() == first.size() &&
+                   matchPart(text.data(), first);
+        }
+        auto const& last = parts_.back();
+        if (text.size() < first.size() + last.size() ||
+            !matchPart(text.data(), first) ||
+            !matchPart(text.data() + text.size() - last.size(), last)) {
+            return false;
+        }
+
+        // Since parts have fixed length, taking the first place each
+        // middle part fits leaves the most room for the rest
+        size_t pos = first.size();
+        size_t end = text.size() - last.size();
+        for (size_t i = 1; i + 1 < parts_.size(); i++) {
+            auto const& part = parts_[i];
+            while (pos + part.size() <= end &&
+                   !matchPart(text.data() + pos, part)) {
+                pos++;
+            }
+            if (pos + part.size() > end) {
+                return false;
+            }
+            pos += part.size();
+        }
+        return true;
+    }
+};
@@ -0,0 +1,13 @@
+#include "catch.hpp"
+#include "glob.h"
+
+TEST_CASE("glob", "")
+{
+    REQUIRE(Glob{"*"}.match(""));
+    REQUIRE(Glob{"tests/*"}.match("tests/a/b.cpp"));
+    REQUIRE(!Glob{"tests/*"}.match("src/tests/b.cpp"));
+    REQUIRE(Glob{"*magic*"}.match("readability-magic-numbers"));
+    REQUIRE(Glob{"a?c*c"}.match("abcc"));
+    REQUIRE(!Glob{"a*bc*bc"}.match("abcbc_"));
+    REQUIRE(Glob{"a*bc*bc"}.match("abcbc"));
+}
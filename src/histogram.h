@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Counts durations in buckets that grow exponentially, each about 19%
+// wider than the one before, so percentiles can be found with a fixed
+// amount of memory however many durations are added.
+class Histogram
+{
+    static constexpr int SubBuckets = 4;
+    // Up to 2^40 microseconds
+    static constexpr size_t BucketCount = 40 * SubBuckets + 1;
+
+    std::array<uint64_t, BucketCount> buckets_{};
+    uint64_t count_ = 0;
+    double max_ = 0;
+
+    static size_t bucket(double us)
+    {
+        if (us < 1) {
+            return 0;
+        }
+        auto b = static_cast<size_t>(std::log2(us) * SubBuckets) + 1;
+        return std::min(b, BucketCount - 1);
+    }
+
+    // The upper limit of a bucket in milliseconds
+    static double limit(size_t b)
+    {
+        return std::exp2(static_cast<double>(b) / SubBuckets) / 1000.0;
+    }
+
+public:
+    void add(double ms)
+    {
+        buckets_[bucket(ms * 1000.0)]++;
+        count_++;
+        max_ = std::max(max_, ms);
+    }
+
+    uint64_t count() const { return count_; }
+    double max() const { return max_; }
+
+    // The duration in milliseconds that the given fraction of all
+    // durations are within, rounded up to the limit of its bucket
+    double percentile(double fraction) const
+    {
+        auto rank = static_cast<uint64_t>(
+            std::ceil(fraction * static_cast<double>(count_)));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BucketCount; b++) {
+            seen += buckets_[b];
+            if (seen >= rank && seen > 0) {
+                return std::min(limit(b), max_);
+            }
+        }
+        return max_;
+    }
+
+    // Call f(limit, count) for each bucket that is not empty
+    template <typename F>
+    void forEachBucket(F f) const
+    {
+        for (size_t b = 0; b < BucketCount; b++) {
+            if (buckets_[b] > 0) {
+                f(limit(b), buckets_[b]);
+            }
+        }
+    }
+};
+
+// Adds the time from construction to destruction to a histogram
+class ScopedTimer
+{
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Histogram& h)
+        : histogram(h), start(std::chrono::steady_clock::now())
+    {}
+    ~ScopedTimer()
+    {
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        histogram.add(ms.count());
+    }
+
+    ScopedTimer(ScopedTimer const&) = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+};
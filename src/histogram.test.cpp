@@ -0,0 +1,18 @@
+#include "catch.hpp"
+#include "histogram.h"
+
+TEST_CASE("histogram", "")
+{
+    Histogram h;
+    REQUIRE(h.percentile(0.5) == 0);
+    for (int i = 1; i <= 100; i++) {
+        h.add(i);
+    }
+    REQUIRE(h.count() == 100);
+    REQUIRE(h.max() == 100);
+    // Within the 19% width of a bucket
+    REQUIRE(h.percentile(0.5) >= 50);
+    REQUIRE(h.percentile(0.5) < 50 * 1.19);
+    REQUIRE(h.percentile(0.99) >= 99);
+    REQUIRE(h.percentile(1.0) == 100);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <set>
+#include <utility>
+
+// A set of [start, end) ranges that can tell if a new range overlaps any
+// of them in O(log n).
+// Ranges are expected to never overlap each other, since overlapping
+// ranges are rejected by checking overlaps() before insert(). An empty
+// range is an insertion point, which only overlaps a range that strictly
+// contains it.
+class IntervalIndex
+{
+    std::multiset<std::pair<size_t, size_t>> ranges_;
+
+public:
+    bool empty() const { return ranges_.empty(); }
+    size_t size() const { return ranges_.size(); }
+
+    void insert(size_t start, size_t end) { ranges_.emplace(start, end); }
+
+    void erase(size_t start, size_t end)
+    {
+        auto it = ranges_.find({start, end});
+        if (it != ranges_.end()) {
+            ranges_.erase(it);
+        }
+    }
+
+    bool overlaps(size_t start, size_t end) const
+    {
+        auto it = ranges_.lower_bound({start, 0});
+
+        // Since ranges do not overlap, only the closest range starting
+        // before us can reach into our range
+        if (it != ranges_.begin()) {
+            auto const& prev = *std::prev(it);
+            if (prev.second > start) {
+                return true;
+            }
+        }
+        if (start == end) {
+            return false;
+        }
+
+        // Any non empty range starting at the same position overlaps, and
+        // so does any range starting inside us
+        for (; it != ranges_.end() && it->first < end; ++it) {
+            if (it->first > start || it->second > start) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "check_registry.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Inverted indexes from check, check category, file and directory to the
+// issues that have them, so a list of issues can be filtered or counted by
+// any of them without looking at the issues themselves.
+//
+// Issues are referred to by their position in the order they were added.
+// Lists of positions are always sorted, so filters can be combined by
+// intersecting them.
+class IssueIndex
+{
+public:
+    enum Group
+    {
+        Check,
+        Category,
+        File,
+        Directory,
+        GroupCount
+    };
+
+private:
+    struct Keys
+    {
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> names;
+        std::vector<std::vector<uint32_t>> positions;
+    };
+
+    std::array<Keys, GroupCount> keys_;
+    std::vector<int> issues_;
+    // The key of each group for each position
+    std::vector<std::array<uint32_t, GroupCount>> issueKeys_;
+
+    uint32_t intern(Group group, std::string const& name)
+    {
+        auto& keys = keys_[group];
+        auto it = keys.ids.find(name);
+        if (it != keys.ids.end()) {
+            return it->second;
+        }
+        auto id = static_cast<uint32_t>(keys.names.size());
+        keys.ids.emplace(name, id);
+        keys.names.push_back(name);
+        keys.positions.emplace_back();
+        return id;
+    }
+
+public:
+    bool empty() const { return issues_.empty(); }
+    size_t size() const { return issues_.size(); }
+
+    void add(int issue, std::string const& check, std::string const& file,
+             std::string const& directory)
+    {
+        auto position = static_cast<uint32_t>(issues_.size());
+        auto const* info = checkInfo(check);
+        std::array<uint32_t, GroupCount> ids{
+            {intern(Check, check),
+             intern(Category, info ? info->category : checkCategory(check)),
+             intern(File, file), intern(Directory, directory)}};
+        for (size_t g = 0; g < GroupCount; g++) {
+            keys_[g].positions[ids[g]].push_back(position);
+        }
+        issues_.push_back(issue);
+        issueKeys_.push_back(ids);
+    }
+
+    int issue(size_t position) const { return issues_[position]; }
+
+    std::string const& name(Group group, uint32_t key) const
+    {
+        return keys_[group].names[key];
+    }
+
+    std::vector<uint32_t> all() const
+    {
+        std::vector<uint32_t> result(issues_.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = static_cast<uint32_t>(i);
+        }
+        return result;
+    }
+
+    // The positions in the list that have the given key
+    std::vector<uint32_t> filter(std::vector<uint32_t> const& positions,
+                                 Group group, uint32_t key) const
+    {
+        auto const& matching = keys_[group].positions[key];
+        if (positions.size() == issues_.size()) {
+            return matching;
+        }
+        std::vector<uint32_t> result;
+        std::set_intersection(positions.begin(), positions.end(),
+                              matching.begin(), matching.end(),
+                              std::back_inserter(result));
+        return result;
+    }
+
+    // Number of positions in the list for each key of a group, most
+    // common first
+    std::vector<std::pair<uint32_t, size_t>>
+    counts(std::vector<uint32_t> const& positions, Group group) const
+    {
+        std::vector<size_t> count(keys_[group].names.size());
+        for (auto p : positions) {
+            count[issueKeys_[p][group]]++;
+        }
+        std::vector<std::pair<uint32_t, size_t>> result;
+        for (size_t key = 0; key < count.size(); key++) {
+            if (count[key] > 0) {
+                result.emplace_back(static_cast<uint32_t>(key), count[key]);
+            }
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [](auto const& a, auto const& b) {
+                             return a.second > b.second;
+                         });
+        return result;
+    }
+};
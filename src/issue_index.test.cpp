@@ -0,0 +1,31 @@
+#include "catch.hpp"
+#include "issue_index.h"
+
+#include <cstdint>
+#include <vector>
+
+TEST_CASE("issue_index", "")
+{
+    IssueIndex index;
+    index.add(7, "a-check", "src/x.cpp", "src");
+    index.add(3, "b-check", "src/y.cpp", "src");
+    index.add(5, "a-check", "lib/z.cpp", "lib");
+
+    auto all = index.all();
+    auto counts = index.counts(all, IssueIndex::Check);
+    REQUIRE(counts.size() == 2);
+    REQUIRE(index.name(IssueIndex::Check, counts[0].first) == "a-check");
+    REQUIRE(counts[0].second == 2);
+
+    auto checks = index.filter(all, IssueIndex::Check, counts[0].first);
+    REQUIRE(checks == std::vector<uint32_t>{0, 2});
+    auto dirs = index.counts(checks, IssueIndex::Directory);
+    REQUIRE(dirs.size() == 2);
+    auto inLib = index.filter(checks, IssueIndex::Directory, dirs[1].first);
+    REQUIRE(inLib.size() == 1);
+    REQUIRE(index.issue(inLib[0]) == 5);
+
+    auto categories = index.counts(all, IssueIndex::Category);
+    REQUIRE(categories.size() == 2);
+    REQUIRE(index.name(IssueIndex::Category, categories[0].first) == "a");
+}
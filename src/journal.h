@@ -0,0 +1,123 @@
+#pragma once
+
+#include "path.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// An append-only log of the changes made during a session. Records are
+// written before the files they describe are touched, so if autotidy dies
+// in the middle of a session the journal can be used on the next start to
+// roll back or replay the changes. The journal is removed on clean exit.
+//
+// Each record is a type character followed by length prefixed fields, and
+// ends with a line feed. A record cut short by a crash is ignored.
+class Journal
+{
+    utils::path fileName_;
+    FILE* fp_ = nullptr;
+
+    void open()
+    {
+        if (fp_ == nullptr) {
+            utils::create_directories(fileName_.parent_path());
+            fp_ = fopen(fileName_.string().c_str(), "ab");
+        }
+    }
+
+public:
+    struct Record
+    {
+        char type;
+        std::vector<std::string> fields;
+    };
+
+    explicit Journal(utils::path const& fileName) : fileName_(fileName) {}
+    ~Journal() { close(); }
+
+    Journal(Journal const&) = delete;
+    Journal& operator=(Journal const&) = delete;
+
+    // Check if an earlier session left changes behind
+    bool pending() const
+    {
+        auto* fp = fopen(fileName_.string().c_str(), "rb");
+        if (fp == nullptr) {
+            return false;
+        }
+        bool empty = fgetc(fp) == EOF;
+        fclose(fp);
+        return !empty;
+    }
+
+    void write(char type, std::vector<std::string> const& fields)
+    {
+        open();
+        if (fp_ == nullptr) {
+            return;
+        }
+        fputc(type, fp_);
+        for (auto const& f : fields) {
+            fprintf(fp_, " %zu:", f.length());
+            fwrite(f.data(), 1, f.length(), fp_);
+        }
+        fputc('\n', fp_);
+    }
+
+    // Make sure everything written so far survives a crash
+    void sync()
+    {
+        if (fp_ != nullptr) {
+            fflush(fp_);
+            fdatasync(fileno(fp_));
+        }
+    }
+
+    std::vector<Record> read() const
+    {
+        std::vector<Record> records;
+        if (fp_ != nullptr) {
+            fflush(fp_);
+        }
+        auto* fp = fopen(fileName_.string().c_str(), "rb");
+        if (fp == nullptr) {
+            return records;
+        }
+        int c = 0;
+        while ((c = fgetc(fp)) != EOF) {
+            Record record{static_cast<char>(c), {}};
+            size_t length = 0;
+            while ((c = fgetc(fp)) == ' ' &&
+                   fscanf(fp, "%zu:", &length) == 1) {
+                std::string field(length, 0);
+                if (fread(&field[0], 1, length, fp) != length) {
+                    break;
+                }
+                record.fields.push_back(std::move(field));
+            }
+            if (c != '\n') {
+                break;
+            }
+            records.push_back(std::move(record));
+        }
+        fclose(fp);
+        return records;
+    }
+
+    void close()
+    {
+        if (fp_ != nullptr) {
+            fclose(fp_);
+            fp_ = nullptr;
+        }
+    }
+
+    // Forget all changes, after a clean exit or a recovery
+    void clear()
+    {
+        close();
+        utils::remove(fileName_);
+    }
+};
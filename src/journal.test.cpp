@@ -0,0 +1,51 @@
+#include "catch.hpp"
+#include "journal.h"
+#include "replacer.h"
+#include "utils.h"
+
+#include <cstdio>
+
+TEST_CASE("journal", "")
+{
+    Journal journal{"temp.journal"};
+    journal.clear();
+
+    copyFileToFrom("tempfile7.txt", "testfile.txt");
+    auto original = readFile("tempfile7.txt");
+
+    // Leave a session without finishing it
+    auto crash = [&] {
+        Replacer replacer;
+        replacer.setJournal(&journal);
+        replacer.applyFixes({{{"tempfile7.txt", 70, 4, "REPLACEMENT"}},
+                             {{"tempfile7.txt", 154, 0, "NEW\n"}}});
+        replacer.appendToLine("tempfile7.txt", 12, " // COMMENT");
+        replacer.undo();
+        return readFile("tempfile7.txt");
+    };
+
+    auto patched = crash();
+    REQUIRE(journal.pending());
+    REQUIRE(journal.read().size() == 4);
+    Replacer::recover(journal, false);
+    REQUIRE(!journal.pending());
+    REQUIRE(readFile("tempfile7.txt") == original);
+    REQUIRE(!utils::exists("tempfile7.txt.orig"));
+
+    REQUIRE(crash() == patched);
+    Replacer::recover(journal, true);
+    REQUIRE(readFile("tempfile7.txt") == patched);
+    REQUIRE(!utils::exists("tempfile7.txt.orig"));
+}
+
+TEST_CASE("journal_path", "")
+{
+    // The directories of a journal are created from an empty path
+    REQUIRE((utils::path{} / "dir").string() == "dir");
+    Journal journal{"journaltest/sub/journal"};
+    journal.write('X', {"field"});
+    REQUIRE(journal.read().size() == 1);
+    journal.clear();
+    std::remove("journaltest/sub");
+    std::remove("journaltest");
+}
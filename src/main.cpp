@@ -1,14 +1,27 @@
 #include "autotidy.h"
+#include "doc_search.h"
 #include "path.h"
+#include "profiles.h"
+#include "tidy_cache.h"
+#include "tidy_results.h"
+#include "tool_probe.h"
 #include "utils.h"
 
 #include <CLI/CLI.hpp>
+#include <absl/strings/str_join.h>
 #include <absl/strings/str_split.h>
 #include <absl/types/optional.h>
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <future>
+#include <iterator>
+#include <set>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -24,6 +37,25 @@ absl::optional<std::string> which(std::string const& executable)
     return absl::nullopt;
 }
 
+// Print the checks whose docs best match a query, with the first line
+// that has a word of it
+void printDocMatches(std::string const& query)
+{
+    auto matches = searchDocs(query);
+    if (matches.empty()) {
+        fmt::print("No documentation matches '{}'\n", query);
+    }
+    for (auto const& m : matches) {
+        fmt::print("{:6.2f} {}\n", m.score, m.name);
+        // Leave out the first line, which is the name of the check
+        auto text = plainText(docPage(m.name));
+        auto line = matchingLine(text.substr(text.find('\n') + 1), query);
+        if (!line.empty()) {
+            fmt::print("       {}\n", line);
+        }
+    }
+}
+
 int main(int argc, char** argv)
 {
     CLI::App app{"autotidy"};
@@ -32,11 +64,23 @@ int main(int argc, char** argv)
     std::string sourceFile;
     std::string headerFilter;
     int headerLevel = 1;
+    int memoryBudget = 512;
     bool runClangTidy = false;
+    bool applyAll = false;
+    bool deferConflicts = false;
+    bool rollback = false;
+    bool resume = false;
     auto fixesFile = "fixes.yaml"s;
     utils::path clangTidy; // = "clang-tidy"s;
     auto diffCommand = "diff -u {0} {1}"s;
     auto configFilename = ".clang-tidy"s;
+    auto rulesFilename = ".autotidy-rules.yaml"s;
+    std::string recordFilename;
+    std::string replayFilename;
+    std::string timingsFilename;
+    std::string profiles;
+    std::string searchQuery;
+    bool printTimings = false;
 
     app.add_option("-l,--log", filename, "clang-tidy output file");
     app.add_option("-s,--source,source", sourceFile,
@@ -51,10 +95,46 @@ int main(int argc, char** argv)
                    "Command to use for performing diff", true);
     app.add_option("-f,--fixes-file", fixesFile,
                    "Exported fixes from clang-tidy", true);
+    app.add_flag("-a,--apply-all", applyAll,
+                 "Apply all fixes without asking");
+    app.add_flag("--defer-conflicts", deferConflicts,
+                 "Review the issues whose fixes conflicted in "
+                 "--apply-all, without their fixes");
+    app.add_option("-m,--memory-budget", memoryBudget,
+                   "Megabytes of file contents to keep in memory, 0 for "
+                   "no limit",
+                   true);
+    app.add_option("-r,--rules", rulesFilename,
+                   "Rules for deciding about issues without asking", true);
+    app.add_option("--record", recordFilename,
+                   "Log all keys pressed to a file");
+    app.add_option("--replay", replayFilename,
+                   "Read keys from a file made with --record, and report "
+                   "the time taken");
+    app.add_flag("--timings", printTimings,
+                 "Print the time spent in each phase of showing an issue");
+    app.add_option("--timings-json", timingsFilename,
+                   "Save the time spent in each phase as JSON");
+    app.add_option("--profiles", profiles,
+                   "Comma separated clang-tidy configs to run in one pass, "
+                   "saving the issues of each separately");
+    app.add_option("--search-docs", searchQuery,
+                   "List the checks whose documentation matches a query");
+    app.add_flag("--resume", resume,
+                 "Continue the session that was quit, without running "
+                 "clang-tidy");
+    app.add_flag("--rollback", rollback,
+                 "Undo the changes of an interrupted session, instead of "
+                 "applying them again");
 
     CLI11_PARSE(app, argc, argv);
 
-    if (sourceFile.empty() && filename.empty()) {
+    if (!searchQuery.empty()) {
+        printDocMatches(searchQuery);
+        return 0;
+    }
+
+    if (sourceFile.empty() && filename.empty() && !resume) {
         std::cout
             << "**Error: Need either a source file or a clang-tidy log.\n";
         return 0;
@@ -64,6 +144,44 @@ int main(int argc, char** argv)
         runClangTidy = true;
     }
 
+    if (!profiles.empty() && sourceFile.empty()) {
+        std::cout << "**Error: --profiles needs a source file.\n";
+        return 0;
+    }
+
+    // Files may be half edited if the last session did not exit cleanly
+    Journal journal{".autotidy/journal"};
+    if (journal.pending()) {
+        fmt::print("Recovering changes from an interrupted session ({})\n",
+                   rollback ? "rolling back" : "replaying");
+        Replacer::recover(journal, !rollback);
+    }
+
+    auto setup = [&](AutoTidy& tidy) {
+        tidy.setJournal(&journal);
+        tidy.setMemoryBudget(static_cast<size_t>(memoryBudget) * 1024 *
+                             1024);
+        tidy.readRules(rulesFilename);
+        tidy.setTimings(printTimings, timingsFilename);
+        if (!recordFilename.empty()) {
+            tidy.recordKeys(recordFilename);
+        }
+        if (!replayFilename.empty() && !tidy.replayKeys(replayFilename)) {
+            std::cout << "**Error: Could not read " << replayFilename
+                      << "\n";
+            return false;
+        }
+        return true;
+    };
+
+    if (resume) {
+        AutoTidy tidy{filename, configFilename, diffCommand, fixesFile};
+        if (setup(tidy) && !tidy.resume()) {
+            std::cout << "**Error: No session to resume.\n";
+        }
+        return 0;
+    }
+
     if (auto executable = which("clang-tidy")) {
         clangTidy = *executable;
     } else {
@@ -71,32 +189,40 @@ int main(int argc, char** argv)
         return 0;
     }
 
-    pipeCommandToFile(fmt::format("{} --version", clangTidy.string()),
-                      ".temp-out");
-
-    std::ifstream versionText(".temp-out");
-    std::string line;
-    while (std::getline(versionText, line)) {
-        auto versionPos = line.find("version");
-        if (versionPos != std::string::npos) {
-            fmt::print("Found clang-tidy : {}\n", line.substr(versionPos));
-            break;
+    // The version is probed in the background, and printed once it is
+    // needed. It is cached for as long as clang-tidy is the same binary,
+    // like the checks and the config, which also depend on the
+    // .clang-tidy files.
+    ToolProbe probe{".autotidy/probes", clangTidy};
+    auto version = std::async(std::launch::async,
+                              [&] { return probe.output("--version"); });
+    auto printVersion = [&] {
+        if (!version.valid()) {
+            return;
         }
-    }
-    versionText.close();
-    std::remove(".temp-out");
+        std::istringstream versionText{version.get()};
+        std::string line;
+        while (std::getline(versionText, line)) {
+            auto versionPos = line.find("version");
+            if (versionPos != std::string::npos) {
+                fmt::print("Found clang-tidy : {}\n", line.substr(versionPos));
+                break;
+            }
+        }
+    };
 
     // Create a .clang-tidy if none exists
-    if (!utils::exists(".clang-tidy")) {
+    if (!utils::exists(configFilename)) {
         AutoTidy tidy{filename, configFilename, diffCommand, fixesFile};
         auto cmdLine = fmt::format("{} -dump-config", clangTidy.string());
-        pipeCommandToFile(cmdLine, ".clang-tidy");
+        pipeCommandToFile(cmdLine, configFilename);
         tidy.readConfig();
         tidy.setIgnores({});
         tidy.saveConfig();
     }
 
     if (runClangTidy) {
+        printVersion();
 
         auto fullPath = utils::resolve(sourceFile);
 
@@ -121,13 +247,91 @@ int main(int argc, char** argv)
         utils::remove(filename);
         utils::remove(fixesFile);
 
+        // With profiles, clang-tidy runs the checks of all of them at once,
+        // and the issues are split by profile afterwards
+        std::vector<Profile> loadedProfiles;
+        std::set<std::string> allChecks;
+        std::set<std::string> checks;
+        if (!profiles.empty()) {
+            auto error = readProfiles(profiles, loadedProfiles);
+            if (!error.empty()) {
+                std::cout << "**Error: " << error << "\n";
+                return 0;
+            }
+            allChecks = TidyCache::listChecks(probe, sourceFile, "*");
+            checks = profileChecks(loadedProfiles, allChecks);
+            if (checks.empty()) {
+                std::cout << "**Error: The profiles enable none of the "
+                             "checks of clang-tidy.\n";
+                return 0;
+            }
+        } else {
+            checks = TidyCache::listChecks(probe, sourceFile);
+        }
+
+        // If only the checks changed since the last run, reuse its results
+        // and run just the checks that were added
+        TidyCache cache{
+            ".autotidy/cache", utils::resolve(sourceFile),
+            TidyCache::settings(probe, sourceFile, headerFilter)};
+        bool cached = !checks.empty() && cache.load();
+        std::set<std::string> added;
+        if (cached) {
+            std::set_difference(checks.begin(), checks.end(),
+                                cache.checks().begin(), cache.checks().end(),
+                                std::inserter(added, added.end()));
+        }
+
         auto cmdLine = fmt::format("{} -export-fixes={} -header-filter='{}' {}",
                                    clangTidy.string(), fixesFile, headerFilter,
                                    sourceFile);
-        fmt::print("Running `{}`\n", cmdLine);
-        pipeCommandToFile(cmdLine, filename);
+        if (cached && !added.empty()) {
+            cmdLine = fmt::format("{} -checks='-*,{}'", cmdLine,
+                                  absl::StrJoin(added, ","));
+        } else if (!cached && !loadedProfiles.empty()) {
+            cmdLine = fmt::format("{} -checks='-*,{}'", cmdLine,
+                                  absl::StrJoin(checks, ","));
+        }
+        if (!cached || !added.empty()) {
+            fmt::print("Running `{}`\n", cmdLine);
+            pipeCommandToFile(cmdLine, filename);
+        }
+        if (cached) {
+            fmt::print("Reusing results of {} unchanged checks\n",
+                       checks.size() - added.size());
+            cache.merge(checks, added, filename, fixesFile);
+        }
+        if (!checks.empty()) {
+            cache.store(checks, filename, fixesFile);
+        }
+
+        if (!loadedProfiles.empty()) {
+            auto results = TidyResults::read(filename, fixesFile);
+            for (auto& profile : loadedProfiles) {
+                auto logFile = withSuffix(filename, profile.name);
+                auto profileFixes = withSuffix(fixesFile, profile.name);
+                auto profileResults = results;
+                profileResults.filter([&](std::string const& check) {
+                    return profile.has(check, allChecks);
+                });
+                profileResults.write(logFile, profileFixes);
+                fmt::print("{}: {} issues in {} and {}\n", profile.fileName,
+                           profileResults.size(), logFile, profileFixes);
+            }
+            return 0;
+        }
     }
 
     AutoTidy tidy{filename, configFilename, diffCommand, fixesFile};
-    tidy.run();
+    if (!setup(tidy)) {
+        return 0;
+    }
+    // Read the issues while clang-tidy is being probed
+    tidy.load();
+    printVersion();
+    if (applyAll) {
+        tidy.applyAll(deferConflicts);
+    } else {
+        tidy.run();
+    }
 }
@@ -1,27 +1,265 @@
-#include "utils.h"
+#include "check_registry.h"
+#include "doc_blob.h"
+#include "doc_search.h"
 #include "path.h"
+#include "utils.h"
 
+#include <absl/strings/str_join.h>
+#include <absl/strings/str_split.h>
 #include <fmt/format.h>
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Lines that many pages have in common, like the boilerplate that
+// rst2man adds, for the pages to refer to when they are compressed
+std::string makeDictionary(std::map<std::string, std::string> const& pages)
+{
+    constexpr size_t MaxSize = 32 * 1024;
+
+    std::map<std::string, size_t> counts;
+    for (auto const& page : pages) {
+        std::set<std::string> lines;
+        for (auto line : absl::StrSplit(page.second, '\n')) {
+            lines.emplace(line);
+        }
+        for (auto const& line : lines) {
+            counts[line]++;
+        }
+    }
+    // Most bytes saved first
+    std::vector<std::pair<size_t, std::string>> common;
+    for (auto const& c : counts) {
+        if (c.second >= 2 && c.first.size() >= 4) {
+            common.emplace_back(c.second * c.first.size(), c.first);
+        }
+    }
+    std::sort(common.rbegin(), common.rend());
+
+    std::string dictionary;
+    for (auto const& c : common) {
+        if (dictionary.size() + c.second.size() + 1 > MaxSize) {
+            break;
+        }
+        // Put the most common lines last, where they are closest
+        dictionary = c.second + "\n" + dictionary;
+    }
+    return dictionary;
+}
+
+// The check registry; every page named like a check, placed in the slot
+// of its perfect hash
+std::string checkRegistry(std::map<std::string, std::string> const& pages)
+{
+    std::vector<std::string> names;
+    std::map<std::string, uint16_t> docs;
+    for (auto const& page : pages) {
+        auto doc = static_cast<uint16_t>(docs.size());
+        docs[page.first] = doc;
+        if (page.first.find('-') != std::string::npos) {
+            names.push_back(page.first);
+        }
+    }
+    auto seeds = perfectHashSeeds(names);
+    if (seeds.empty()) {
+        throw std::runtime_error("No perfect hash for the check names");
+    }
+
+    std::vector<std::string> rows(names.size());
+    for (auto const& name : names) {
+        auto slot = checkSlot(name.data(), name.size(), seeds.data(),
+                              seeds.size(), names.size());
+        rows[slot] = fmt::format("    {{\"{}\", \"{}\", {}}},\n", name,
+                                 checkCategory(name), docs[name]);
+    }
+
+    auto source = fmt::format("extern constexpr CheckInfo checkInfos[] = {{\n"
+                              "{}}};\n"
+                              "extern const size_t checkCount = {};\n"
+                              "extern constexpr uint16_t checkSeeds[] = {{",
+                              absl::StrJoin(rows, ""), names.size());
+    for (size_t i = 0; i < seeds.size(); i++) {
+        source += fmt::format("{}{}", i % 12 == 0 ? "\n    " : " ",
+                              seeds[i]);
+        if (i + 1 < seeds.size()) {
+            source += ",";
+        }
+    }
+    source += fmt::format("}};\nextern const size_t checkSeedCount = {};\n\n",
+                          seeds.size());
+    return source;
+}
+
+// Write a file, unless it already has the same contents, so the build does
+// not redo anything when the docs have not changed
+void updateFile(utils::path const& fileName, std::string const& contents)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    std::stringstream old;
+    old << in.rdbuf();
+    if (!in || old.str() != contents) {
+        std::ofstream out(fileName, std::ios::binary);
+        out << contents;
+    }
+}
+
+// Write manpages.bin; a dictionary followed by the pages compressed one by
+// one and the search index, and manpages.cpp; an index of the pages sorted
+// by name and the check registry, that embeds manpages.bin with .incbin
+void writeDocs(std::map<std::string, std::string> const& pages,
+               utils::path const& outDir)
+{
+    auto data = makeDictionary(pages);
+    auto dictionarySize = data.size();
+    auto source = fmt::format("// Generated by makedoc, do not edit\n"
+                              "#include \"check_registry.h\"\n"
+                              "#include \"doc_blob.h\"\n\n"
+                              "extern constexpr DocEntry docIndex[] = {{\n");
+    for (auto const& page : pages) {
+        auto packed =
+            lzCompress(page.second, data.substr(0, dictionarySize));
+        source += fmt::format("    {{\"{}\", {}, {}, {}}},\n", page.first,
+                              data.size(), packed.size(), page.second.size());
+        data += packed;
+    }
+    auto searchOffset = data.size();
+    data += buildSearchIndex({pages.begin(), pages.end()});
+    source += fmt::format(
+        "}};\n"
+        "extern const size_t docCount = "
+        "sizeof(docIndex) / sizeof(docIndex[0]);\n"
+        "extern const size_t docDictionarySize = {};\n"
+        "extern const size_t docSearchOffset = {};\n\n"
+        "{}"
+        "// The data is assembled straight from manpages.bin, which is much\n"
+        "// faster to build than an array literal. Compilers without GNU\n"
+        "// style inline assembly get the array from bin2cpp.cmake instead.\n"
+        "#ifndef DOC_DATA_ARRAY\n"
+        "#ifdef __APPLE__\n"
+        "#define DOC_SECTION \"__DATA,__const\"\n"
+        "#define DOC_SYMBOL \"_docData\"\n"
+        "#else\n"
+        "#define DOC_SECTION \".rodata\"\n"
+        "#define DOC_SYMBOL \"docData\"\n"
+        "#endif\n"
+        "__asm__(\".pushsection \" DOC_SECTION \"\\n\"\n"
+        "        \".global \" DOC_SYMBOL \"\\n\"\n"
+        "        DOC_SYMBOL \":\\n\"\n"
+        "        \".incbin \\\"manpages.bin\\\"\\n\"\n"
+        "        \".popsection\\n\");\n"
+        "#endif\n",
+        dictionarySize, searchOffset, checkRegistry(pages));
+    updateFile(outDir / "manpages.bin", data);
+    updateFile(outDir / "manpages.cpp", source);
+}
+
+// A hash of the contents of a file, to know if it changed
+uint64_t hashFile(utils::path const& fileName)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : readFile(fileName)) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Convert the docs to man pages, in parallel. Converted pages are kept in
+// the cache directory under the hash of their source, so only docs that
+// changed are converted again.
+std::map<std::string, std::string> convertDocs(utils::path const& docDir,
+                                               utils::path const& cacheDir)
+{
+    std::vector<utils::path> docs;
+    for (auto const& p : utils::directory_iterator{docDir}) {
+        if (p.path().extension() == ".rst") {
+            docs.push_back(p.path());
+        }
+    }
+    utils::create_directories(cacheDir);
+
+    std::vector<std::string> pages(docs.size());
+    // Set for the docs that could not be converted
+    std::vector<char> failed(docs.size(), 0);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> converted{0};
+    auto work = [&] {
+        for (size_t i = next++; i < docs.size(); i = next++) {
+            auto cached =
+                cacheDir / fmt::format("{}-{:016x}.man", docs[i].stem(),
+                                       hashFile(docs[i]));
+            if (utils::exists(cached)) {
+                auto data = readFile(cached);
+                pages[i] = std::string(data.begin(), data.end());
+                continue;
+            }
+            int status = 0;
+            pages[i] = pipeCommandToString(
+                fmt::format("rst2man.py {}", docs[i].string()), status);
+            // A failed conversion is never cached, so it is retried on
+            // the next run
+            if (status != 0 || pages[i].empty()) {
+                failed[i] = 1;
+                continue;
+            }
+            // Written to a temporary name first, so an interrupted run
+            // does not leave a partial page in the cache
+            auto temp = cached.string() + ".tmp";
+            writeFile(temp, pages[i]);
+            if (std::rename(temp.c_str(), cached.string().c_str()) != 0) {
+                std::remove(temp.c_str());
+            }
+            converted++;
+        }
+    };
+    std::vector<std::thread> workers;
+    auto threads = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(work);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    fmt::print("Converted {} of {} docs\n", converted.load(), docs.size());
+
+    std::vector<std::string> failedDocs;
+    for (size_t i = 0; i < docs.size(); i++) {
+        if (failed[i] != 0) {
+            failedDocs.push_back(docs[i].filename().string());
+        }
+    }
+    if (!failedDocs.empty()) {
+        throw std::runtime_error("rst2man.py failed for " +
+                                 absl::StrJoin(failedDocs, ", "));
+    }
 
-std::string hexDump(std::vector<char> const& data) {
-    std::string result;
-    for(auto const& c : data) {
-        result += fmt::format("{},", static_cast<int>(c));
+    std::map<std::string, std::string> result;
+    for (size_t i = 0; i < docs.size(); i++) {
+        result[docs[i].stem()] = std::move(pages[i]);
     }
     return result;
 }
 
-int main(int  /*argc*/, char ** /*argv*/)
+// makedoc [doc directory] [output directory]
+int main(int argc, char** argv)
 {
-    std::puts("#include <map>\n#include <string>\nstd::map<std::string, std::string> manPages = {");
-    for(auto const& p : utils::directory_iterator{"extra/clang-checks-doc"}) {
-        pipeCommandToFile(fmt::format("rst2man.py {}", p.path().stem()), "temp.man");
-        auto data = readFile("temp.man");
-        fmt::print("{{ \"{}\", {{ {} }} }},\n", p.path().filename().string(), hexDump(data)); 
+    utils::path docDir = argc > 1 ? argv[1] : "extra/clang-checks-doc";
+    utils::path outDir = argc > 2 ? argv[2] : "src";
+    try {
+        writeDocs(convertDocs(docDir, ".makedoc-cache"), outDir);
+    } catch (std::runtime_error& e) {
+        fmt::print(stderr, "makedoc: {}\n", e.what());
+        return 1;
     }
-    std::puts("};");
     return 0;
 }
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Renders a man page to lines of text for the terminal, with ANSI codes
+// for bold and underlined text. Only the subset of roff that rst2man
+// writes is handled; macro definitions, registers and other requests
+// that do not change the text are skipped.
+class ManRenderer
+{
+    enum Font
+    {
+        Regular,
+        Bold,
+        Italic
+    };
+
+    // A word with the ANSI codes in it, and its width on screen
+    struct Word
+    {
+        std::string text;
+        size_t width = 0;
+    };
+
+    static constexpr int SectionIndent = 4;
+    static constexpr int SubsectionIndent = 2;
+    static constexpr int TagIndent = 4;
+
+    size_t width_;
+    std::vector<std::string> lines_;
+    Font font_ = Regular;
+    bool fill_ = true;
+    bool inMacro_ = false;
+    // 0 outside tables, 1 in the format of a table, 2 in its data
+    int table_ = 0;
+    std::vector<std::string> tableLines_;
+
+    int indent_ = SectionIndent;
+    std::vector<int> indents_;
+    // Extra indent of the body of .IP and .TP paragraphs
+    int bodyIndent_ = 0;
+    // Tag of .IP and .TP, shown before the body
+    Word tag_;
+    bool tagNext_ = false;
+    std::vector<Word> words_;
+
+    static char const* code(Font font)
+    {
+        static char const* const codes[] = {"\x1b[0m", "\x1b[1m", "\x1b[4m"};
+        return codes[font];
+    }
+
+    static std::string special(std::string const& name)
+    {
+        static std::pair<char const*, char const*> const chars[] = {
+            {"ga", "`"},  {"aq", "'"},  {"bu", "•"}, {"co", "©"},
+            {"em", "--"}, {"en", "-"},  {"lq", "\""},     {"rq", "\""},
+            {"dq", "\""}, {"oq", "'"},  {"cq", "'"},      {"ti", "~"},
+            {"ha", "^"},  {"rs", "\\"}, {"mi", "-"},      {"pl", "+"},
+            {"<=", "<="}, {">=", ">="}, {"->", "->"},     {"<-", "<-"}};
+        for (auto const& c : chars) {
+            if (name == c.first) {
+                return c.second;
+            }
+        }
+        return "";
+    }
+
+    // Number of characters in UTF-8 text
+    static size_t visibleWidth(std::string const& text)
+    {
+        size_t width = 0;
+        for (auto c : text) {
+            if ((c & 0xc0) != 0x80) {
+                width++;
+            }
+        }
+        return width;
+    }
+
+    // Convert the escapes of a line to text and ANSI codes, split into
+    // words unless split is false
+    std::vector<Word> words(std::string const& text, bool split)
+    {
+        std::vector<Word> result;
+        Word word;
+        bool started = false;
+        auto start = [&] {
+            if (!started) {
+                started = true;
+                if (font_ != Regular) {
+                    word.text = code(font_);
+                }
+            }
+        };
+        auto add = [&](std::string const& s, size_t width) {
+            start();
+            word.text += s;
+            word.width += width;
+        };
+        auto finish = [&] {
+            if (started) {
+                if (font_ != Regular) {
+                    word.text += code(Regular);
+                }
+                result.push_back(std::move(word));
+                word = Word{};
+                started = false;
+            }
+        };
+        auto setFont = [&](Font font) {
+            if (font != font_ && started) {
+                word.text += code(Regular);
+                if (font != Regular) {
+                    word.text += code(font);
+                }
+            }
+            font_ = font;
+        };
+
+        for (size_t i = 0; i < text.size(); i++) {
+            auto c = text[i];
+            if (c == '\t') {
+                c = ' ';
+            }
+            if (c == ' ' && split) {
+                finish();
+                continue;
+            }
+            if (c != '\\' || i + 1 >= text.size()) {
+                std::string s(1, c);
+                add(s, visibleWidth(s));
+                continue;
+            }
+            auto e = text[++i];
+            switch (e) {
+            case 'f': {
+                auto f = i + 1 < text.size() ? text[++i] : 'R';
+                if (f == '(' && i + 2 < text.size()) {
+                    i += 2;
+                    f = 'R';
+                }
+                setFont(f == 'B' ? Bold : f == 'I' ? Italic : Regular);
+                break;
+            }
+            case '(':
+                if (i + 2 < text.size()) {
+                    auto s = special(text.substr(i + 1, 2));
+                    i += 2;
+                    add(s, visibleWidth(s));
+                }
+                break;
+            case '-':
+                add("-", 1);
+                break;
+            case 'e':
+            case '\\':
+                add("\\", 1);
+                break;
+            case ' ':
+            case '~':
+                add(" ", 1);
+                break;
+            case '&':
+            case '|':
+            case '^':
+            case 'c':
+                start();
+                break;
+            default:
+                add(std::string(1, e), 1);
+                break;
+            }
+        }
+        finish();
+        return result;
+    }
+
+    void blank()
+    {
+        if (!lines_.empty() && !lines_.back().empty()) {
+            lines_.emplace_back();
+        }
+    }
+
+    // Write out the words of the filled paragraph, wrapped to the width
+    void flush()
+    {
+        auto indent = static_cast<size_t>(indent_ + bodyIndent_);
+        auto avail = width_ > indent + 10 ? width_ - indent : 10;
+        std::string line;
+        size_t length = 0;
+        if (!tag_.text.empty()) {
+            line = std::string(indent_, ' ') + tag_.text;
+            length = tag_.width;
+            if (length + 1 > static_cast<size_t>(bodyIndent_) ||
+                words_.empty()) {
+                lines_.push_back(line);
+                line.clear();
+                length = 0;
+            } else {
+                line += std::string(bodyIndent_ - length, ' ');
+                length = 0;
+            }
+            tag_ = Word{};
+        }
+        for (auto const& word : words_) {
+            if (length > 0 && length + 1 + word.width > avail) {
+                lines_.push_back(line);
+                line.clear();
+                length = 0;
+            }
+            if (line.empty()) {
+                line = std::string(indent, ' ');
+            } else if (length > 0) {
+                line += ' ';
+                length++;
+            }
+            line += word.text;
+            length += word.width;
+        }
+        if (!line.empty()) {
+            lines_.push_back(line);
+        }
+        words_.clear();
+    }
+
+    // Split a request into its name and arguments
+    static std::vector<std::string> arguments(std::string const& line)
+    {
+        std::vector<std::string> args;
+        size_t i = 1;
+        while (i < line.size()) {
+            while (i < line.size() && line[i] == ' ') {
+                i++;
+            }
+            if (i >= line.size()) {
+                break;
+            }
+            std::string arg;
+            if (line[i] == '"') {
+                for (i++; i < line.size() && line[i] != '"'; i++) {
+                    arg += line[i];
+                }
+                i++;
+            } else {
+                for (; i < line.size() && line[i] != ' '; i++) {
+                    arg += line[i];
+                }
+            }
+            args.push_back(arg);
+        }
+        return args;
+    }
+
+    void pushIndent(int indent)
+    {
+        flush();
+        indents_.push_back(indent_);
+        indent_ += indent;
+    }
+
+    void popIndent()
+    {
+        flush();
+        if (!indents_.empty()) {
+            indent_ = indents_.back();
+            indents_.pop_back();
+        }
+    }
+
+    void startParagraph()
+    {
+        flush();
+        bodyIndent_ = 0;
+    }
+
+    // Join words with single spaces, and give the width of the result
+    Word join(std::vector<Word> const& w)
+    {
+        Word result;
+        for (auto const& word : w) {
+            if (!result.text.empty()) {
+                result.text += ' ';
+                result.width++;
+            }
+            result.text += word.text;
+            result.width += word.width;
+        }
+        return result;
+    }
+
+    // Lay out the rows of a table in columns. Cells are separated by tabs,
+    // and text between T{ and T} can span lines. A row of '_' is a rule.
+    void renderTable()
+    {
+        std::vector<std::vector<Word>> rows;
+        std::vector<Word> row;
+        std::string block;
+        bool inBlock = false;
+        auto cells = [&](std::string const& text) {
+            size_t start = 0;
+            while (start <= text.size()) {
+                auto end = text.find('\t', start);
+                auto cell = text.substr(start, end - start);
+                if (cell == "T{") {
+                    inBlock = true;
+                    return;
+                }
+                row.push_back(join(words(cell, true)));
+                if (end == std::string::npos) {
+                    break;
+                }
+                start = end + 1;
+            }
+        };
+        for (auto const& line : tableLines_) {
+            if (inBlock) {
+                if (line.compare(0, 2, "T}") != 0) {
+                    block += line + " ";
+                    continue;
+                }
+                inBlock = false;
+                row.push_back(join(words(block, true)));
+                block.clear();
+                if (line.size() > 3 && line[2] == '\t') {
+                    cells(line.substr(3));
+                }
+            } else if (line == "_" || line == "=") {
+                rows.emplace_back();
+            } else {
+                cells(line);
+            }
+            if (!inBlock) {
+                if (!row.empty()) {
+                    rows.push_back(std::move(row));
+                }
+                row.clear();
+            }
+        }
+        tableLines_.clear();
+
+        std::vector<size_t> widths;
+        for (auto const& r : rows) {
+            widths.resize(std::max(widths.size(), r.size()));
+            for (size_t c = 0; c < r.size(); c++) {
+                widths[c] = std::max(widths[c], r[c].width);
+            }
+        }
+        size_t total = 0;
+        for (auto w : widths) {
+            total += total == 0 ? w : w + 3;
+        }
+        auto indent = std::string(indent_ + bodyIndent_, ' ');
+        for (auto const& r : rows) {
+            if (r.empty()) {
+                lines_.push_back(indent + std::string(total, '-'));
+                continue;
+            }
+            std::string line = indent;
+            for (size_t c = 0; c < r.size(); c++) {
+                line += r[c].text + std::string(widths[c] - r[c].width + 3,
+                                                ' ');
+            }
+            lines_.push_back(line.substr(0, line.find_last_not_of(' ') + 1));
+        }
+    }
+
+    void request(std::string const& line)
+    {
+        auto args = arguments(line);
+        if (args.empty()) {
+            return;
+        }
+        auto name = args[0];
+        args.erase(args.begin());
+        auto number = [&](size_t i, double fallback) {
+            return i < args.size() && !args[i].empty()
+                       ? static_cast<int>(std::lround(std::atof(
+                             args[i].c_str())))
+                       : static_cast<int>(fallback);
+        };
+        std::string rest;
+        for (auto const& a : args) {
+            rest += (rest.empty() ? "" : " ") + a;
+        }
+
+        if (name == "de" || name == "de1" || name == "ig") {
+            inMacro_ = true;
+        } else if (name == "TH") {
+            lines_.push_back(std::string(code(Bold)) + rest.substr(
+                                 0, rest.find(' ')) + code(Regular));
+        } else if (name == "SH" || name == "SS") {
+            startParagraph();
+            indents_.clear();
+            blank();
+            auto indent = name == "SH" ? 0 : SubsectionIndent;
+            font_ = Regular;
+            lines_.push_back(std::string(indent, ' ') + code(Bold) + rest +
+                             code(Regular));
+            indent_ = SectionIndent;
+        } else if (name == "sp" || name == "PP" || name == "P" ||
+                   name == "LP") {
+            startParagraph();
+            blank();
+        } else if (name == "nf") {
+            flush();
+            fill_ = false;
+        } else if (name == "fi") {
+            fill_ = true;
+        } else if (name == "ft") {
+            auto f = args.empty() ? 'R' : args[0][0];
+            font_ = f == 'B' ? Bold : f == 'I' ? Italic : Regular;
+        } else if (name == "INDENT" || name == "RS") {
+            pushIndent(number(0, name == "RS" ? TagIndent : 0));
+        } else if (name == "UNINDENT" || name == "RE") {
+            popIndent();
+        } else if (name == "IP") {
+            startParagraph();
+            blank();
+            bodyIndent_ = number(1, TagIndent);
+            if (!args.empty()) {
+                auto tag = words(args[0], false);
+                tag_ = tag.empty() ? Word{} : tag[0];
+            }
+        } else if (name == "TP") {
+            startParagraph();
+            blank();
+            bodyIndent_ = number(0, TagIndent);
+            tagNext_ = true;
+        } else if (name == "B" || name == "I") {
+            auto font = font_;
+            font_ = name == "B" ? Bold : Italic;
+            text(rest);
+            font_ = font;
+        } else if (name == "TS") {
+            flush();
+            blank();
+            table_ = 1;
+        } else if (name == "TE") {
+            table_ = 0;
+            renderTable();
+        }
+    }
+
+    void text(std::string const& line)
+    {
+        if (tagNext_) {
+            tagNext_ = false;
+            auto tag = words(line, false);
+            tag_ = tag.empty() ? Word{} : tag[0];
+            return;
+        }
+        if (table_ == 2) {
+            tableLines_.push_back(line);
+            return;
+        }
+        if (fill_) {
+            auto w = words(line, true);
+            if (w.empty()) {
+                startParagraph();
+                blank();
+            }
+            words_.insert(words_.end(), w.begin(), w.end());
+            return;
+        }
+        auto w = words(line, false);
+        lines_.push_back(std::string(indent_ + bodyIndent_, ' ') +
+                         (w.empty() ? "" : w[0].text));
+    }
+
+public:
+    explicit ManRenderer(size_t width) : width_(width) {}
+
+    std::vector<std::string> render(std::string const& page)
+    {
+        std::istringstream in{page};
+        std::string line;
+        while (std::getline(in, line)) {
+            if (inMacro_) {
+                inMacro_ = line != "..";
+                continue;
+            }
+            if (table_ == 1) {
+                // The format of a table ends with a '.'
+                table_ = !line.empty() && line.back() == '.' ? 2 : 1;
+                continue;
+            }
+            if (!line.empty() && (line[0] == '.' || line[0] == '\'')) {
+                if (line.compare(1, 2, "\\\"") != 0) {
+                    request(line);
+                }
+                continue;
+            }
+            text(line);
+        }
+        flush();
+        while (!lines_.empty() && lines_.back().empty()) {
+            lines_.pop_back();
+        }
+        return std::move(lines_);
+    }
+};
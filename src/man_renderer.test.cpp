@@ -0,0 +1,31 @@
+#include "catch.hpp"
+#include "man_renderer.h"
+
+#include <string>
+
+TEST_CASE("man_renderer", "")
+{
+    auto lines = ManRenderer{40}.render(
+        ".\\\" comment\n"
+        ".TH CHECK  \"\" \"\"\n"
+        ".de1 INDENT\n"
+        ". RS \\\\$1\n"
+        "..\n"
+        ".SH NAME\n"
+        "Use \\fBnullptr\\fP instead of \\(gaNULL\\(ga or 0 in all of\n"
+        "the code.\n"
+        ".INDENT 0.0\n"
+        ".INDENT 3.5\n"
+        ".nf\n"
+        "int* a = nullptr;\n"
+        ".fi\n"
+        ".UNINDENT\n"
+        ".UNINDENT\n");
+    REQUIRE(lines.size() == 6);
+    REQUIRE(lines[0] == "\x1b[1mCHECK\x1b[0m");
+    REQUIRE(lines[2] == "\x1b[1mNAME\x1b[0m");
+    REQUIRE(lines[3] ==
+            "    Use \x1b[1mnullptr\x1b[0m instead of `NULL` or 0");
+    REQUIRE(lines[4] == "    in all of the code.");
+    REQUIRE(lines[5] == "        int* a = nullptr;");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <absl/strings/match.h>
+#include <absl/strings/str_split.h>
+#include <absl/strings/string_view.h>
+#include <fmt/format.h>
+
+#include <string>
+#include <vector>
+
+// Template instantiation backtraces can be thousands of lines long, so
+// runs of "in instantiation of" notes, each with the source lines that
+// follow it, are replaced by the first and last one and a count of the
+// hidden notes.
+inline std::string collapseNotes(std::string const& text, size_t& hidden)
+{
+    std::vector<absl::string_view> lines = absl::StrSplit(text, '\n');
+
+    // Each note starts a frame, that ends where the next note starts
+    std::vector<size_t> frames{0};
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0 && absl::StrContains(lines[i], ": note: ")) {
+            frames.push_back(i);
+        }
+    }
+    frames.push_back(lines.size());
+    auto isInstantiation = [&](size_t frame) {
+        return absl::StrContains(lines[frames[frame]], "in instantiation of");
+    };
+
+    std::string result;
+    auto addLines = [&](size_t first, size_t last) {
+        for (auto i = first; i < last; i++) {
+            result.append(lines[i].data(), lines[i].size());
+            result += '\n';
+        }
+    };
+    hidden = 0;
+    auto frameCount = frames.size() - 1;
+    for (size_t frame = 0; frame < frameCount;) {
+        auto last = frame;
+        while (last + 1 < frameCount && isInstantiation(frame) &&
+               isInstantiation(last + 1)) {
+            last++;
+        }
+        addLines(frames[frame], frames[frame + 1]);
+        if (last > frame + 1) {
+            hidden += last - frame - 1;
+            result += fmt::format(
+                "    ... {} more notes 'in instantiation of', [e] to expand\n",
+                last - frame - 1);
+        }
+        if (last > frame) {
+            addLines(frames[last], frames[last + 1]);
+        }
+        frame = last + 1;
+    }
+    if (!result.empty()) {
+        result.pop_back();
+    }
+    return result;
+}
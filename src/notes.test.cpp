@@ -0,0 +1,37 @@
+#include "catch.hpp"
+#include "notes.h"
+
+#include <fmt/format.h>
+
+#include <string>
+
+TEST_CASE("collapse_notes", "")
+{
+    auto note = [](int n) {
+        return fmt::format("a.h:{}:1: note: in instantiation of 'f<{}>' "
+                           "requested here\n  f<{}>();\n  ^\n",
+                           n, n, n);
+    };
+    std::string text = "a.cpp:1:1: warning: bad [some-check]\n  x;\n";
+    for (int n = 1; n <= 5; n++) {
+        text += note(n);
+    }
+    text += "a.cpp:9:1: note: declared here\n  y;";
+
+    size_t hidden = 0;
+    auto result = collapseNotes(text, hidden);
+    REQUIRE(hidden == 3);
+    REQUIRE(result.find("f<1>") != std::string::npos);
+    REQUIRE(result.find("f<5>") != std::string::npos);
+    for (int n = 2; n <= 4; n++) {
+        REQUIRE(result.find(fmt::format("f<{}>", n)) == std::string::npos);
+    }
+    REQUIRE(result.find("... 3 more notes 'in instantiation of'") !=
+            std::string::npos);
+    REQUIRE(result.find("declared here\n  y;") != std::string::npos);
+
+    // Two notes in a row are both shown
+    text = "a.cpp:1:1: warning: bad [some-check]\n" + note(1) + note(2);
+    REQUIRE(collapseNotes(text, hidden) == text);
+    REQUIRE(hidden == 0);
+}
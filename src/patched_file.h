@@ -1,10 +1,14 @@
 #pragma once
 
+#include "interval_index.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 // Saves the patches of a file, so subsequent patches can happen at the
@@ -13,12 +17,62 @@ class PatchedFile
 {
     std::string fileName_;
     std::vector<std::pair<size_t, size_t>> patches_;
+    // Original offset and length of each patch
+    std::vector<std::pair<size_t, size_t>> ranges_;
+    IntervalIndex patched_;
     std::vector<char> contents_;
+    // Set when contents_ differ from the file on disk
+    bool dirty_ = false;
+    // Counts the changes made to this file
+    size_t version_ = 0;
+    // Original offset and change in size of each patch, sorted by offset,
+    // for the version they were sorted for
+    mutable std::vector<std::pair<size_t, int64_t>> shifts_;
+    mutable size_t shiftsVersion_ = SIZE_MAX;
+
+    // A function that translates original offsets, like translateOffset(),
+    // but in a single walk over the patches. The offsets must be given in
+    // ascending order.
+    auto translator() const
+    {
+        if (shiftsVersion_ != version_) {
+            shifts_.clear();
+            for (size_t i = 0; i < patches_.size(); i++) {
+                shifts_.emplace_back(
+                    ranges_[i].first,
+                    static_cast<int64_t>(patches_[i].second));
+            }
+            std::sort(shifts_.begin(), shifts_.end());
+            shiftsVersion_ = version_;
+        }
+        size_t next = 0;
+        int64_t shift = 0;
+        return [this, next, shift](size_t offset) mutable {
+            for (; next < shifts_.size() && shifts_[next].first < offset;
+                 next++) {
+                shift += shifts_[next].second;
+            }
+            return static_cast<size_t>(static_cast<int64_t>(offset) + shift);
+        };
+    }
 
 public:
     PatchedFile() = default;
     explicit PatchedFile(std::string const& fileName) : fileName_(fileName) {}
 
+    // A file patched in an earlier session, with its patches and their
+    // original ranges. The patches can not be reverted.
+    PatchedFile(std::string const& fileName,
+                std::vector<std::pair<size_t, size_t>> patches,
+                std::vector<std::pair<size_t, size_t>> ranges)
+        : fileName_(fileName), patches_(std::move(patches)),
+          ranges_(std::move(ranges)), version_(patches_.size())
+    {
+        for (auto const& r : ranges_) {
+            patched_.insert(r.first, r.first + r.second);
+        }
+    }
+
     std::vector<char> const& contents()
     {
         if (contents_.empty()) {
@@ -28,10 +82,25 @@ public:
     }
 
     auto const& patches() const { return patches_; }
+    auto const& ranges() const { return ranges_; }
     auto const& fileName() const { return fileName_; }
 
     void setFileName(std::string const& fileName) { fileName_ = fileName; }
 
+    size_t memoryUsage() const { return contents_.capacity(); }
+    size_t version() const { return version_; }
+
+    // Free the contents if they are saved, they will be read back from the
+    // file when needed. The patches are kept, so offsets still translate.
+    bool evict()
+    {
+        if (dirty_) {
+            return false;
+        }
+        std::vector<char>().swap(contents_);
+        return true;
+    }
+
     size_t translateOffset(size_t offset) const
     {
         for (auto const& p : patches_) {
@@ -42,15 +111,85 @@ public:
         return offset;
     }
 
-    // Patch this file, respecting the prevous patches_
-    void patch(size_t offset, size_t length, std::string const& text)
+    // The original offset of an offset in the current contents. An offset
+    // inside patched text maps to the end of the text that was replaced.
+    size_t untranslateOffset(size_t offset) const
+    {
+        for (size_t i = patches_.size(); i-- > 0;) {
+            auto start = patches_[i].first;
+            auto delta = static_cast<int64_t>(patches_[i].second);
+            auto length = ranges_[i].second;
+            auto end = static_cast<size_t>(
+                static_cast<int64_t>(start + length) + delta);
+            if (offset >= end) {
+                offset = static_cast<size_t>(static_cast<int64_t>(offset) -
+                                             delta);
+            } else if (offset > start) {
+                offset = start + length;
+            }
+        }
+        return offset;
+    }
+
+    // The current line and column (both 1-based) of original offsets,
+    // which must be sorted. All are found in one pass over the contents.
+    std::vector<std::pair<int, int>>
+    lineColumns(std::vector<size_t> const& offsets)
+    {
+        auto const& data = contents();
+        std::vector<std::pair<int, int>> result;
+        result.reserve(offsets.size());
+        size_t pos = 0;
+        size_t lineStart = 0;
+        int line = 1;
+        auto translate = translator();
+        for (auto offset : offsets) {
+            offset = std::min(translate(offset), data.size());
+            for (; pos < offset; pos++) {
+                if (data[pos] == '\n') {
+                    line++;
+                    lineStart = pos + 1;
+                }
+            }
+            result.emplace_back(line, static_cast<int>(offset - lineStart) + 1);
+        }
+        return result;
+    }
+
+    // The current text at an original offset
+    std::string text(size_t offset, size_t length)
+    {
+        auto const& data = contents();
+        offset = std::min(translateOffset(offset), data.size());
+        length = std::min(length, data.size() - offset);
+        return {data.begin() + offset, data.begin() + offset + length};
+    }
+
+    // Check if patching the original text at offset would touch text
+    // that has already been patched
+    bool overlaps(size_t offset, size_t length) const
+    {
+        return patched_.overlaps(offset, offset + length);
+    }
+
+    // Patch this file, respecting the prevous patches_. Returns the text
+    // that was replaced, so the patch can be reverted by unpatch().
+    std::string patch(size_t offset, size_t length, std::string const& text)
     {
         // Make sure contents is available
         (void)contents();
 
+        ranges_.emplace_back(offset, length);
+        patched_.insert(offset, offset + length);
+        dirty_ = true;
+        version_++;
+
         // offset depends on prevous patches
         offset = translateOffset(offset);
 
+        std::string removed(contents_.begin() + offset,
+                            contents_.begin() + offset + length);
+
         auto newLength = text.length();
         auto insertIterator = contents_.begin() + offset;
 
@@ -68,14 +207,89 @@ public:
         patches_.emplace_back(offset, delta);
 
         std::copy(text.begin(), text.end(), insertIterator);
+        return removed;
+    }
+
+    // Patch a range of replacements sorted by offset, that do not overlap
+    // each other or previous patches, in a single pass from the current
+    // contents into a new buffer. The patches are recorded as if they were
+    // applied one by one in order, so they can be reverted by unpatch() in
+    // reverse order. Returns the replaced texts.
+    template <typename Iterator>
+    std::vector<std::string> patchSorted(Iterator first, Iterator last)
+    {
+        (void)contents();
+
+        std::vector<size_t> offsets;
+        size_t growth = 0;
+        auto translate = translator();
+        for (auto it = first; it != last; ++it) {
+            offsets.push_back(translate(it->offset));
+            if (it->text.length() > it->length) {
+                growth += it->text.length() - it->length;
+            }
+        }
+
+        std::vector<char> result;
+        result.reserve(contents_.size() + growth);
+        std::vector<std::string> removed;
+
+        size_t pos = 0;
+        int64_t shift = 0;
+        auto offset = offsets.begin();
+        for (auto it = first; it != last; ++it, ++offset) {
+            auto start = contents_.begin() + *offset;
+            result.insert(result.end(), contents_.begin() + pos, start);
+            removed.emplace_back(start, start + it->length);
+            result.insert(result.end(), it->text.begin(), it->text.end());
+            pos = *offset + it->length;
+
+            int64_t delta = static_cast<int64_t>(it->text.length()) -
+                            static_cast<int64_t>(it->length);
+            patches_.emplace_back(static_cast<int64_t>(*offset) + shift,
+                                  delta);
+            shift += delta;
+            ranges_.emplace_back(it->offset, it->length);
+            patched_.insert(it->offset, it->offset + it->length);
+        }
+        result.insert(result.end(), contents_.begin() + pos, contents_.end());
+        contents_ = std::move(result);
+        dirty_ = true;
+        version_++;
+        return removed;
+    }
+
+    // Revert the last patch, putting back the text it replaced
+    void unpatch(std::string const& removed)
+    {
+        if (patches_.empty()) {
+            return;
+        }
+        (void)contents();
+
+        auto offset = patches_.back().first;
+        auto delta = static_cast<int64_t>(patches_.back().second);
+        auto inserted = static_cast<int64_t>(removed.length()) + delta;
+
+        auto it = contents_.begin() + offset;
+        it = contents_.erase(it, it + inserted);
+        contents_.insert(it, removed.begin(), removed.end());
+
+        patches_.pop_back();
+        dirty_ = true;
+        version_++;
+        patched_.erase(ranges_.back().first,
+                       ranges_.back().first + ranges_.back().second);
+        ranges_.pop_back();
     }
 
-    void flush() const
+    void flush()
     {
         if (contents_.empty()) {
             return;
         }
         writeFile(fileName_, std::string(contents_.begin(), contents_.end()));
+        dirty_ = false;
     }
 
     bool operator==(const std::string& other) const
@@ -1,10 +1,16 @@
 #include "catch.hpp"
+#include "interval_index.h"
+#include "journal.h"
 #include "patched_file.h"
 #include "replacer.h"
 #include "utils.h"
 
+#include <fmt/format.h>
+
+#include <chrono>
 #include <cstdio>
 #include <string>
+#include <tuple>
 #include <vector>
 
 using namespace std::string_literals;
@@ -65,13 +71,260 @@ TEST_CASE("replacer", "")
     copyFileToFrom("tempfile0.txt", "testfile.txt");
     copyFileToFrom("tempfile1.txt", "testfile.txt");
 
-    replacer.applyReplacement({"tempfile0.txt", 70, 4, "REPLACEMENT"});
+    replacer.applyReplacements({{"tempfile0.txt", 70, 4, "REPLACEMENT"}});
     replacer.appendToLine("tempfile0.txt", 12, " // COMMENT");
-    replacer.applyReplacement({"tempfile0.txt", 154, 0, "NEW "});
-    replacer.applyReplacement({"tempfile0.txt", 201, 1, "RETURN_VALUE"});
+    replacer.applyReplacements({{"tempfile0.txt", 154, 0, "NEW "}});
+    replacer.applyReplacements({{"tempfile0.txt", 201, 1, "RETURN_VALUE"}});
 
-    replacer.applyReplacement({"tempfile1.txt", 201, 1, "RETURN_VALUE"});
-    replacer.applyReplacement({"tempfile1.txt", 154, 0, "NEW "});
+    replacer.applyReplacements({{"tempfile1.txt", 201, 1, "RETURN_VALUE"}});
+    replacer.applyReplacements({{"tempfile1.txt", 154, 0, "NEW "}});
     replacer.appendToLine("tempfile1.txt", 12, " // COMMENT");
-    replacer.applyReplacement({"tempfile1.txt", 70, 4, "REPLACEMENT"});
+    replacer.applyReplacements({{"tempfile1.txt", 70, 4, "REPLACEMENT"}});
+}
+
+TEST_CASE("undo", "")
+{
+    Replacer replacer;
+
+    copyFileToFrom("tempfile2.txt", "testfile.txt");
+    auto original = readFile("tempfile2.txt");
+
+    replacer.applyReplacements({{"tempfile2.txt", 70, 4, "REPLACEMENT"},
+                                {"tempfile2.txt", 154, 0, "NEW "}});
+    replacer.appendToLine("tempfile2.txt", 12, " // COMMENT");
+    auto patched = readFile("tempfile2.txt");
+
+    REQUIRE(replacer.undo());
+    REQUIRE(replacer.undo());
+    REQUIRE(!replacer.undo());
+    REQUIRE(readFile("tempfile2.txt") == original);
+
+    REQUIRE(replacer.redo());
+    REQUIRE(replacer.redo());
+    REQUIRE(!replacer.redo());
+    REQUIRE(readFile("tempfile2.txt") == patched);
+
+    // Later replacements still land at the right offset after an undo
+    REQUIRE(replacer.undo());
+    replacer.applyReplacements({{"tempfile2.txt", 201, 1, "RETURN_VALUE"}});
+    REQUIRE(!replacer.canRedo());
+
+    copyFileToFrom("tempfile3.txt", "testfile.txt");
+    replacer.applyReplacements({{"tempfile3.txt", 70, 4, "REPLACEMENT"}});
+    replacer.applyReplacements({{"tempfile3.txt", 154, 0, "NEW "}});
+    replacer.applyReplacements({{"tempfile3.txt", 201, 1, "RETURN_VALUE"}});
+    REQUIRE(readFile("tempfile2.txt") == readFile("tempfile3.txt"));
+}
+
+TEST_CASE("conflicts", "")
+{
+    IntervalIndex index;
+    index.insert(10, 20);
+    index.insert(30, 30);
+    index.insert(20, 25);
+
+    REQUIRE(!index.overlaps(0, 10));
+    REQUIRE(index.overlaps(5, 11));
+    REQUIRE(index.overlaps(19, 19));
+    REQUIRE(index.overlaps(12, 14));
+    REQUIRE(!index.overlaps(20, 20));
+    REQUIRE(!index.overlaps(25, 30));
+    REQUIRE(index.overlaps(25, 31));
+    REQUIRE(!index.overlaps(30, 30));
+    REQUIRE(!index.overlaps(30, 40));
+    index.erase(10, 20);
+    REQUIRE(!index.overlaps(5, 11));
+
+    Replacer replacer;
+    copyFileToFrom("tempfile4.txt", "testfile.txt");
+    replacer.applyReplacements({{"tempfile4.txt", 70, 4, "REPLACEMENT"}});
+
+    REQUIRE(replacer.conflicts({"tempfile4.txt", 70, 4, "REPLACEMENT"}));
+    REQUIRE(replacer.conflicts({"tempfile4.txt", 72, 0, "X"}));
+    REQUIRE(!replacer.conflicts({"tempfile4.txt", 74, 2, "X"}));
+
+    replacer.undo();
+    REQUIRE(!replacer.conflicts({"tempfile4.txt", 70, 4, "REPLACEMENT"}));
+}
+
+TEST_CASE("batch", "")
+{
+    Replacer replacer;
+
+    copyFileToFrom("tempfile5.txt", "testfile.txt");
+    copyFileToFrom("tempfile6.txt", "testfile.txt");
+
+    // Same fixes as one at a time, but in any order and in one batch
+    auto rejected = replacer.applyFixes(
+        {{{"tempfile5.txt", 201, 1, "RETURN_VALUE"}},
+         {{"tempfile5.txt", 70, 4, "REPLACEMENT"},
+          {"tempfile5.txt", 154, 0, "NEW "}},
+         {{"tempfile5.txt", 72, 4, "OVERLAP"}, {"tempfile5.txt", 0, 0, "X"}},
+         {{"tempfile5.txt", 201, 1, "RETURN_VALUE"}}});
+    REQUIRE(rejected == std::vector<size_t>{2, 3});
+
+    // The same fixes one at a time, in a separate undo history
+    Replacer oneByOne;
+    oneByOne.applyReplacements({{"tempfile6.txt", 70, 4, "REPLACEMENT"}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 154, 0, "NEW "}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 201, 1, "RETURN_VALUE"}});
+    REQUIRE(readFile("tempfile5.txt") == readFile("tempfile6.txt"));
+
+    // Offsets of later patches are translated past the batch
+    replacer.applyReplacements({{"tempfile5.txt", 204, 0, "END"}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 204, 0, "END"}});
+    REQUIRE(readFile("tempfile5.txt") == readFile("tempfile6.txt"));
+
+    // A batch between and after earlier patches
+    replacer.applyFixes({{{"tempfile5.txt", 10, 2, "AB"}},
+                         {{"tempfile5.txt", 154, 0, "MORE "}},
+                         {{"tempfile5.txt", 205, 1, ""}}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 205, 1, ""}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 10, 2, "AB"}});
+    oneByOne.applyReplacements({{"tempfile6.txt", 154, 0, "MORE "}});
+    REQUIRE(readFile("tempfile5.txt") == readFile("tempfile6.txt"));
+
+    replacer.undo();
+    replacer.undo();
+    replacer.undo();
+    REQUIRE(readFile("tempfile5.txt") == readFile("testfile.txt"));
+}
+
+// Run with `tidytest [.benchmark]`
+TEST_CASE("batch_benchmark", "[.benchmark]")
+{
+    constexpr size_t Lines = 40000;
+    std::string line = "    int* value = NULL; // some text to fill the line\n";
+    std::string text;
+    for (size_t i = 0; i < Lines; i++) {
+        text += line;
+    }
+
+    // Two batches, so the second one is applied on top of many patches
+    auto replacements = [&](size_t column) {
+        std::vector<std::vector<Replacement>> fixes;
+        for (size_t i = 0; i < Lines; i++) {
+            fixes.push_back({{"tempbench.txt", i * line.size() + column, 4,
+                              "nullptr"}});
+        }
+        return fixes;
+    };
+    auto timed = [](auto&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    };
+
+    writeFile("tempbench.txt", text);
+    Replacer replacer;
+    auto first = timed([&] { replacer.applyFixes(replacements(17)); });
+    auto second = timed([&] { replacer.applyFixes(replacements(4)); });
+    replacer.finish();
+
+    writeFile("tempbench.txt", text);
+    Replacer sequential;
+    auto fixes = replacements(17);
+    fixes.resize(Lines / 20);
+    auto oneByOne = timed([&] {
+        for (auto const& fix : fixes) {
+            sequential.applyReplacements(fix);
+        }
+    });
+    sequential.finish();
+    std::remove("tempbench.txt");
+
+    WARN(fmt::format(
+        "{} replacements in a {} KB file:\n  {:<36}{:8.1f} ms\n"
+        "  {:<36}{:8.1f} ms\n  {:<36}{:8.1f} ms",
+        Lines, text.size() / 1024, "applyFixes()", first,
+        fmt::format("applyFixes() after {} patches", Lines), second,
+        fmt::format("applyReplacements(), {} of them", fixes.size()),
+        oneByOne));
+}
+
+TEST_CASE("memory_budget", "")
+{
+    Replacer replacer;
+    replacer.setMemoryBudget(300);
+
+    copyFileToFrom("tempfile8.txt", "testfile.txt");
+    copyFileToFrom("tempfile9.txt", "testfile.txt");
+
+    replacer.applyReplacements({{"tempfile8.txt", 70, 4, "REPLACEMENT"}});
+    REQUIRE(replacer.memoryUsage() > 200);
+    // Second file pushes the first one out
+    replacer.applyReplacements({{"tempfile9.txt", 70, 4, "REPLACEMENT"}});
+    REQUIRE(replacer.memoryUsage() < 300);
+
+    // Evicted file is read back, and still patches at the right offset
+    replacer.applyReplacements({{"tempfile8.txt", 154, 0, "NEW "}});
+    replacer.applyReplacements({{"tempfile9.txt", 154, 0, "NEW "}});
+    REQUIRE(readFile("tempfile8.txt") == readFile("tempfile9.txt"));
+    while (replacer.undo()) {}
+    REQUIRE(readFile("tempfile8.txt") == readFile("testfile.txt"));
+    REQUIRE(readFile("tempfile9.txt") == readFile("testfile.txt"));
+}
+
+TEST_CASE("reanchor", "")
+{
+    Replacer replacer;
+    copyFileToFrom("tempfile10.txt", "testfile.txt");
+
+    // Two new lines before 'return 0;' moves it from line 12 to 14
+    replacer.applyReplacements({{"tempfile10.txt", 139, 0, "// A\n// B\n"},
+                                {"tempfile10.txt", 70, 4, "REPLACEMENT"}});
+    auto positions = replacer.lineColumns("tempfile10.txt", {70, 201});
+    REQUIRE(positions[0] == std::make_pair(3, 8));
+    REQUIRE(positions[1] == std::make_pair(14, 12));
+
+    auto pf = replacer.snapshot("tempfile10.txt");
+    // The single walk agrees with translating each offset on its own
+    std::vector<size_t> offsets{0, 69, 70, 74, 138, 139, 140, 201};
+    positions = pf.lineColumns(offsets);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        auto lc = offsetToLineCol(pf.contents(),
+                                  pf.translateOffset(offsets[i]));
+        REQUIRE(positions[i] == lc);
+    }
+    REQUIRE(pf.untranslateOffset(pf.translateOffset(201)) == 201);
+    // Inside the replaced text maps to the end of what was replaced
+    REQUIRE(pf.untranslateOffset(75) == 74);
+
+    REQUIRE(replacer.appendToLine("tempfile10.txt", 14, " // COMMENT"));
+    auto contents = readFile("tempfile10.txt");
+    auto text = std::string(contents.begin(), contents.end());
+    REQUIRE(text.find("return 0; // COMMENT\n") != std::string::npos);
+    while (replacer.undo()) {}
+    REQUIRE(readFile("tempfile10.txt") == readFile("testfile.txt"));
+}
+
+TEST_CASE("session", "")
+{
+    copyFileToFrom("tempfile11.txt", "testfile.txt");
+    copyFileToFrom("tempfile12.txt", "testfile.txt");
+    utils::remove("temp_session");
+    {
+        Replacer replacer;
+        replacer.applyReplacements({{"tempfile11.txt", 70, 4, "REPLACEMENT"},
+                                    {"tempfile11.txt", 139, 0, "// A\n"}});
+        Journal session{"temp_session"};
+        replacer.saveState(session);
+    }
+
+    // A new session continues with offsets into the original file
+    Replacer replacer;
+    Journal session{"temp_session"};
+    for (auto const& record : session.read()) {
+        replacer.restoreState(record);
+    }
+    REQUIRE(replacer.conflicts({"tempfile11.txt", 72, 1, ""}));
+    replacer.applyReplacements({{"tempfile11.txt", 201, 1, "RETURN_VALUE"}});
+
+    replacer.applyReplacements({{"tempfile12.txt", 70, 4, "REPLACEMENT"},
+                                {"tempfile12.txt", 139, 0, "// A\n"},
+                                {"tempfile12.txt", 201, 1, "RETURN_VALUE"}});
+    REQUIRE(readFile("tempfile11.txt") == readFile("tempfile12.txt"));
+    session.clear();
 }
@@ -70,7 +70,7 @@ class path
         if (i < 0) {
             i += segments.size();
         }
-        if (i < static_cast<int>(segments.size())) {
+        if (i >= 0 && i < static_cast<int>(segments.size())) {
             return segments[i];
         }
         return empty_string;
@@ -81,7 +81,7 @@ class path
         if (i < 0) {
             i += segments.size();
         }
-        if (i < static_cast<int>(segments.size())) {
+        if (i >= 0 && i < static_cast<int>(segments.size())) {
             return segments[i];
         }
         return empty_string;
@@ -114,7 +114,8 @@ public:
         if (p.is_absolute()) {
             *this = p;
         } else {
-            if (segment(-1).empty()) {
+            // An empty path has no trailing empty segment to drop
+            if (!segments.empty() && segment(-1).empty()) {
                 segments.resize(segments.size() - 1);
             }
             segments.insert(std::end(segments), std::begin(p.segments),
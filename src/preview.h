@@ -0,0 +1,206 @@
+#pragma once
+
+#include "replacer.h"
+#include "utils.h"
+
+#include <absl/strings/str_replace.h>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The patched diff shown for an issue
+struct Preview
+{
+    int issue = -1;
+    std::string diff;
+    // Some replacement could be applied
+    bool hasPatch = false;
+    // Some replacement overlaps an applied change
+    bool conflicting = false;
+    // Versions of the files the preview was made from
+    std::map<std::string, size_t> versions;
+    // Milliseconds spent patching the copies, and running diff
+    double patchTime = 0;
+    double diffTime = 0;
+};
+
+// Everything needed to make a preview, without touching the Replacer or
+// reading the real files, which may be written while it is rendered
+struct PreviewJob
+{
+    int issue = -1;
+    std::vector<Replacement> replacements;
+    // Copies of the files as they were when the job was created, with
+    // their contents loaded
+    std::map<std::string, PatchedFile> files;
+    std::map<std::string, size_t> versions;
+};
+
+// Renders previews of upcoming issues on a background thread, while the
+// user looks at the current one.
+class Previewer
+{
+    std::string diffCommand;
+
+    std::mutex lock;
+    std::condition_variable wakeUp;
+    std::deque<PreviewJob> pending;
+    std::map<int, Preview> prepared;
+    bool quit = false;
+    std::thread worker;
+
+    void work()
+    {
+        std::unique_lock<std::mutex> guard{lock};
+        while (true) {
+            wakeUp.wait(guard, [&] { return quit || !pending.empty(); });
+            if (quit) {
+                return;
+            }
+            auto job = std::move(pending.front());
+            pending.pop_front();
+            guard.unlock();
+            auto suffix = std::to_string(job.issue);
+            auto preview = render(std::move(job), diffCommand, suffix);
+            guard.lock();
+            prepared[preview.issue] = std::move(preview);
+        }
+    }
+
+public:
+    explicit Previewer(std::string const& aDiffCommand)
+        : diffCommand(aDiffCommand)
+    {}
+
+    ~Previewer()
+    {
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            quit = true;
+        }
+        wakeUp.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    Previewer(Previewer const&) = delete;
+    Previewer& operator=(Previewer const&) = delete;
+
+    // Patch copies of the files, and diff them against the unpatched
+    // copies. Both are written to tempDir, with '.base' or '.temp' and the
+    // suffix added to their names, and the diff refers to the real names
+    // instead.
+    static Preview render(PreviewJob job, std::string const& diffCommand,
+                          std::string const& suffix = "",
+                          utils::path const& tempDir = ".autotidy/preview")
+    {
+        using Clock = std::chrono::steady_clock;
+        using Ms = std::chrono::duration<double, std::milli>;
+        Preview preview;
+        preview.issue = job.issue;
+        preview.versions = std::move(job.versions);
+        auto start = Clock::now();
+
+        std::map<std::string, PatchedFile*> patched;
+        std::map<std::string, std::vector<char>> bases;
+        for (auto const& r : job.replacements) {
+            auto& pf = job.files[r.path];
+            if (!contains(bases, r.path)) {
+                bases[r.path] = pf.contents();
+            }
+            // Patching text that an earlier change already replaced would
+            // corrupt the file, so such replacements are left out
+            if (pf.overlaps(r.offset, r.length)) {
+                preview.conflicting = true;
+                continue;
+            }
+            pf.patch(r.offset, r.length, r.text);
+            patched[r.path] = &pf;
+            preview.hasPatch = true;
+        }
+
+        if (!patched.empty()) {
+            utils::create_directories(tempDir);
+        }
+        // Files with the same name in different directories are told apart
+        // by their number
+        size_t n = 0;
+        for (auto const& p : patched) {
+            auto name = fmt::format("{}-{}", n++,
+                                    utils::path{p.first}.filename().string());
+            auto base = (tempDir / (name + ".base" + suffix)).string();
+            auto temp = (tempDir / (name + ".temp" + suffix)).string();
+            auto const& original = bases[p.first];
+            writeFile(base, std::string(original.begin(), original.end()));
+            p.second->setFileName(temp);
+            p.second->flush();
+            auto diffStart = Clock::now();
+            preview.patchTime += Ms(diffStart - start).count();
+            auto diff =
+                pipeCommandToString(fmt::format(diffCommand, base, temp));
+            preview.diff +=
+                absl::StrReplaceAll(diff, {{base, p.first}, {temp, p.first}});
+            utils::remove(base);
+            utils::remove(temp);
+            start = Clock::now();
+            preview.diffTime += Ms(start - diffStart).count();
+        }
+        return preview;
+    }
+
+    // Replace the queue of previews to prepare. Finished previews are kept
+    // if they are still wanted.
+    void schedule(std::vector<PreviewJob> jobs)
+    {
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            std::map<int, Preview> keep;
+            pending.clear();
+            for (auto& job : jobs) {
+                auto it = prepared.find(job.issue);
+                if (it != prepared.end() &&
+                    it->second.versions == job.versions) {
+                    keep[job.issue] = std::move(it->second);
+                } else {
+                    pending.push_back(std::move(job));
+                }
+            }
+            prepared = std::move(keep);
+        }
+        if (!worker.joinable()) {
+            worker = std::thread{[this] { work(); }};
+        }
+        wakeUp.notify_one();
+    }
+
+    // Check if the preview of an issue has been prepared, from the given
+    // versions of its files
+    bool ready(int issue, std::map<std::string, size_t> const& versions)
+    {
+        std::lock_guard<std::mutex> guard{lock};
+        auto it = prepared.find(issue);
+        return it != prepared.end() && it->second.versions == versions;
+    }
+
+    // Get the preview of an issue, if it has been prepared
+    bool take(int issue, Preview& preview)
+    {
+        std::lock_guard<std::mutex> guard{lock};
+        auto it = prepared.find(issue);
+        if (it == prepared.end()) {
+            return false;
+        }
+        preview = std::move(it->second);
+        prepared.erase(it);
+        return true;
+    }
+};
@@ -0,0 +1,60 @@
+#include "catch.hpp"
+#include "patched_file.h"
+#include "preview.h"
+#include "utils.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("previewer", "")
+{
+    copyFileToFrom("tempfile0.txt", "testfile.txt");
+    auto makeJob = [](int issue) {
+        PreviewJob job;
+        job.issue = issue;
+        job.replacements = {{"tempfile0.txt", 70, 4, "REPLACEMENT"}};
+        job.files["tempfile0.txt"] = PatchedFile{"tempfile0.txt"};
+        (void)job.files["tempfile0.txt"].contents();
+        job.versions["tempfile0.txt"] = 0;
+        return job;
+    };
+
+    Previewer previewer{"diff -u {} {}"};
+    std::vector<PreviewJob> jobs;
+    jobs.push_back(makeJob(1));
+    jobs.push_back(makeJob(2));
+    previewer.schedule(std::move(jobs));
+    auto versions = makeJob(1).versions;
+    for (int i = 0; i < 500 && !previewer.ready(2, versions); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(previewer.ready(1, versions));
+    REQUIRE(previewer.ready(2, versions));
+
+    // A finished preview that is still wanted survives the next schedule,
+    // even when its job only has the versions
+    jobs.clear();
+    PreviewJob stub;
+    stub.issue = 1;
+    stub.versions = versions;
+    jobs.push_back(std::move(stub));
+    previewer.schedule(std::move(jobs));
+    Preview preview;
+    REQUIRE(previewer.take(1, preview));
+    REQUIRE(preview.hasPatch);
+    REQUIRE(preview.diff.find("+") != std::string::npos);
+    REQUIRE(preview.diff.find("REPLACEMENT") != std::string::npos);
+    // The diff refers to the real file, not the unpatched copy
+    REQUIRE(preview.diff.find("--- tempfile0.txt") != std::string::npos);
+    REQUIRE(preview.diff.find("+++ tempfile0.txt") != std::string::npos);
+    REQUIRE(preview.diff.find(".base") == std::string::npos);
+    // The copies are made away from the sources, and removed again
+    REQUIRE(!utils::exists("tempfile0.txt.base1"));
+    REQUIRE(!utils::exists(".autotidy/preview/0-tempfile0.txt.base1"));
+
+    // Previews that are not wanted any more are dropped
+    previewer.schedule({});
+    REQUIRE(!previewer.take(2, preview));
+}
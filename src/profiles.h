@@ -0,0 +1,104 @@
+#pragma once
+
+#include "check_filter.h"
+
+#include <absl/strings/str_split.h>
+#include <yaml-cpp/yaml.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+// A clang-tidy config whose Checks make up a profile. The checks of all
+// profiles are run by one clang-tidy run, and the issues are then split
+// into a log and fixes file per profile.
+struct Profile
+{
+    std::string fileName;
+    // The file name without directory and extension, which is added to
+    // the names of the log and fixes files of the profile
+    std::string name;
+    CheckFilter filter;
+
+    static std::string nameOf(std::string const& fileName)
+    {
+        auto name = fileName.substr(fileName.find_last_of('/') + 1);
+        return name.substr(0, name.find_last_of('.'));
+    }
+
+    // Issues that are not from an available check, like compiler errors,
+    // belong to all profiles
+    bool has(std::string const& check,
+             std::set<std::string> const& available)
+    {
+        return available.count(check) == 0 || filter.enabled(check);
+    }
+};
+
+// Read the Checks option of a clang-tidy config. Returns an error message
+// if it can not be read.
+inline std::string readProfile(std::string const& fileName,
+                               CheckFilter& filter)
+{
+    try {
+        auto config = YAML::LoadFile(fileName);
+        filter.setChecks(config.IsMap() && config["Checks"]
+                             ? config["Checks"].as<std::string>()
+                             : "");
+    } catch (YAML::Exception& e) {
+        return "Could not read " + fileName + ": " + e.what();
+    }
+    return "";
+}
+
+// Read a comma separated list of profiles. Returns an error message if one
+// can not be read, or if two have the same name, since their issues would
+// be written to the same files.
+inline std::string readProfiles(std::string const& list,
+                                std::vector<Profile>& profiles)
+{
+    std::set<std::string> names;
+    for (auto const& fileName : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+        profiles.emplace_back();
+        auto& profile = profiles.back();
+        profile.fileName = std::string(fileName);
+        profile.name = Profile::nameOf(profile.fileName);
+        if (!names.insert(profile.name).second) {
+            return "More than one profile is named '" + profile.name + "'";
+        }
+        auto error = readProfile(profile.fileName, profile.filter);
+        if (!error.empty()) {
+            return error;
+        }
+    }
+    return "";
+}
+
+// The available checks that some profile enables
+inline std::set<std::string>
+profileChecks(std::vector<Profile>& profiles,
+              std::set<std::string> const& available)
+{
+    std::set<std::string> checks;
+    for (auto const& check : available) {
+        for (auto& profile : profiles) {
+            if (profile.filter.enabled(check)) {
+                checks.insert(check);
+                break;
+            }
+        }
+    }
+    return checks;
+}
+
+// Add a suffix to a file name before its extension, if any
+inline std::string withSuffix(std::string const& fileName,
+                              std::string const& suffix)
+{
+    auto dot = fileName.find_last_of('.');
+    if (dot == std::string::npos ||
+        fileName.find('/', dot) != std::string::npos) {
+        return fileName + "." + suffix;
+    }
+    return fileName.substr(0, dot) + "." + suffix + fileName.substr(dot);
+}
@@ -0,0 +1,60 @@
+#include "catch.hpp"
+#include "profiles.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+TEST_CASE("profiles", "")
+{
+    REQUIRE(withSuffix("fixes.yaml", "strict") == "fixes.strict.yaml");
+    REQUIRE(withSuffix("tidy", "strict") == "tidy.strict");
+    REQUIRE(withSuffix("out.d/tidy", "strict") == "out.d/tidy.strict");
+    REQUIRE(Profile::nameOf("conf/strict.yaml") == "strict");
+
+    utils::create_directories("proftest/other");
+    writeFile("proftest/strict.yaml",
+              "Checks: 'modernize-*,-modernize-use-trailing-return-type'\n");
+    writeFile("proftest/style.yaml", "Checks: 'readability-*'\n");
+    writeFile("proftest/other/strict.yaml", "Checks: 'bugprone-*'\n");
+    writeFile("proftest/scalar.yaml", "just a scalar\n");
+
+    std::set<std::string> available{"bugprone-use-after-move",
+                                    "modernize-use-nullptr",
+                                    "modernize-use-trailing-return-type",
+                                    "readability-magic-numbers"};
+    std::vector<Profile> profiles;
+    REQUIRE(readProfiles("proftest/strict.yaml,proftest/style.yaml,",
+                         profiles) == "");
+    REQUIRE(profiles.size() == 2);
+    REQUIRE(profiles[0].name == "strict");
+    REQUIRE(profileChecks(profiles, available) ==
+            std::set<std::string>{"modernize-use-nullptr",
+                                  "readability-magic-numbers"});
+    // Issues are split by profile, and ones not from a check go to all
+    REQUIRE(profiles[0].has("modernize-use-nullptr", available));
+    REQUIRE(!profiles[0].has("readability-magic-numbers", available));
+    REQUIRE(profiles[1].has("clang-diagnostic-error", available));
+
+    // Profiles with the same name would write the same files
+    profiles.clear();
+    REQUIRE(readProfiles("proftest/strict.yaml,proftest/other/strict.yaml",
+                         profiles) != "");
+
+    // A profile without Checks enables nothing
+    profiles.clear();
+    REQUIRE(readProfiles("proftest/scalar.yaml", profiles) == "");
+    REQUIRE(profileChecks(profiles, available).empty());
+
+    profiles.clear();
+    REQUIRE(readProfiles("proftest/missing.yaml", profiles) != "");
+
+    for (auto const* f :
+         {"proftest/strict.yaml", "proftest/style.yaml",
+          "proftest/other/strict.yaml", "proftest/scalar.yaml",
+          "proftest/other", "proftest"}) {
+        std::remove(f);
+    }
+}
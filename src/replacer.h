@@ -1,10 +1,17 @@
 #pragma once
 
+#include "journal.h"
 #include "patched_file.h"
 
 #include <algorithm>
+#include <iterator>
+#include <list>
 #include <map>
+#include <set>
+#include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 // Represent a replacement to be applied in a text file
 struct Replacement
@@ -28,8 +35,68 @@ struct Replacement
 // Keep track of a set of patched files
 class Replacer
 {
+    // A step that can be undone; the replacements it applied, sorted by
+    // file and offset, and the texts they replaced
+    struct Step
+    {
+        std::vector<Replacement> replacements;
+        std::vector<std::string> removed;
+    };
+
     std::map<std::string, PatchedFile> patchedFiles;
 
+    std::vector<Step> undoStack;
+    std::vector<Step> redoStack;
+
+    Journal* journal = nullptr;
+
+    // File buffers in least recently used order, with their memory use
+    struct RecentFile
+    {
+        std::string name;
+        size_t bytes;
+    };
+    std::list<RecentFile> recentFiles;
+    std::map<std::string, std::list<RecentFile>::iterator> recentIndex;
+    size_t memoryUsed = 0;
+    size_t memoryBudget = 0;
+
+    void forgetFile(std::string const& name)
+    {
+        auto it = recentIndex.find(name);
+        if (it != recentIndex.end()) {
+            memoryUsed -= it->second->bytes;
+            recentFiles.erase(it->second);
+            recentIndex.erase(it);
+        }
+    }
+
+    // Mark a file as most recently used, then evict the least recently
+    // used buffers until memory use is within budget. Call this when the
+    // file has been flushed.
+    void touchFile(std::string const& name)
+    {
+        forgetFile(name);
+        auto bytes = patchedFiles[name].memoryUsage();
+        memoryUsed += bytes;
+        recentIndex[name] =
+            recentFiles.insert(recentFiles.end(), {name, bytes});
+
+        if (memoryBudget == 0) {
+            return;
+        }
+        auto it = recentFiles.begin();
+        while (memoryUsed > memoryBudget && it != recentFiles.end()) {
+            if (patchedFiles[it->name].evict()) {
+                memoryUsed -= it->bytes;
+                recentIndex.erase(it->name);
+                it = recentFiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     PatchedFile& getPatchedFile(std::string const& name)
     {
         auto it = patchedFiles.find(name);
@@ -39,16 +106,186 @@ class Replacer
         // If this is the first time we reference this file,
         // make a copy
         copyFileToFrom(name + ".orig", name);
+        // The backup is complete, so recovery can restore from it
+        if (journal != nullptr) {
+            journal->write('F', {name});
+            journal->sync();
+        }
         patchedFiles.emplace(name, PatchedFile{name});
         return patchedFiles[name];
     }
 
+    void writeStep(Step const& step)
+    {
+        if (journal == nullptr) {
+            return;
+        }
+        std::vector<std::string> fields;
+        for (auto const& r : step.replacements) {
+            fields.insert(fields.end(), {r.path, std::to_string(r.offset),
+                                         std::to_string(r.length), r.text});
+        }
+        journal->write('S', fields);
+        journal->sync();
+    }
+
+    // Write a record before touching any files
+    void writeJournal(char type)
+    {
+        if (journal != nullptr) {
+            journal->write(type, {});
+            journal->sync();
+        }
+    }
+
+    // Patch all replacements of a step, in one pass and one write per file
+    void applyStep(Step& step)
+    {
+        step.removed.clear();
+        auto const& rs = step.replacements;
+        for (auto first = rs.begin(); first != rs.end();) {
+            auto last =
+                std::find_if(first, rs.end(), [&](Replacement const& r) {
+                    return r.path != first->path;
+                });
+            auto& pf = getPatchedFile(first->path);
+            auto removed = pf.patchSorted(first, last);
+            std::move(removed.begin(), removed.end(),
+                      std::back_inserter(step.removed));
+            pf.flush();
+            touchFile(first->path);
+            first = last;
+        }
+    }
+
 public:
+    // Without a journal, backups are not needed after the session. With a
+    // journal they are kept for recovery until finish() is called.
     ~Replacer()
+    {
+        if (journal == nullptr) {
+            finish();
+        }
+    }
+
+    // End the session cleanly, removing backups and the journal
+    void finish()
     {
         for (auto const& p : patchedFiles) {
             std::remove((std::get<const std::string>(p) + ".orig").c_str());
         }
+        if (journal != nullptr) {
+            journal->clear();
+        }
+    }
+
+    // Limit the memory used for file buffers, 0 means no limit
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    size_t memoryUsage() const { return memoryUsed; }
+
+    // Log all changes to a journal, so they can be recovered after a crash
+    void setJournal(Journal* j) { journal = j; }
+
+    // Write the patch state of every file, so a later session can keep
+    // patching them with offsets into the original files
+    void saveState(Journal& out) const
+    {
+        for (auto const& p : patchedFiles) {
+            std::vector<std::string> fields{p.first};
+            auto const& patches = p.second.patches();
+            auto const& ranges = p.second.ranges();
+            for (size_t i = 0; i < patches.size(); i++) {
+                fields.insert(fields.end(),
+                              {std::to_string(patches[i].first),
+                               std::to_string(patches[i].second),
+                               std::to_string(ranges[i].first),
+                               std::to_string(ranges[i].second)});
+            }
+            out.write('P', fields);
+        }
+    }
+
+    // Continue patching a file from a state written by saveState()
+    void restoreState(Journal::Record const& record)
+    {
+        auto const& f = record.fields;
+        if (f.empty()) {
+            return;
+        }
+        std::vector<std::pair<size_t, size_t>> patches;
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t i = 1; i + 3 < f.size(); i += 4) {
+            patches.emplace_back(std::stoull(f[i]), std::stoull(f[i + 1]));
+            ranges.emplace_back(std::stoull(f[i + 2]), std::stoull(f[i + 3]));
+        }
+        auto const& name = f[0];
+        forgetFile(name);
+        patchedFiles.erase(name);
+        // Back up the file as it is now, and log the state, so changes
+        // made from here can be recovered
+        getPatchedFile(name) = PatchedFile{name, patches, ranges};
+        if (journal != nullptr) {
+            journal->write('P', f);
+            journal->sync();
+        }
+    }
+
+    // Restore the files changed in an unfinished session from their
+    // backups, then optionally apply the same changes again.
+    static void recover(Journal& journal, bool replay)
+    {
+        auto records = journal.read();
+
+        std::set<std::string> backedUp;
+        std::set<std::string> patched;
+        for (auto const& record : records) {
+            if (record.type == 'F' && !record.fields.empty()) {
+                backedUp.insert(record.fields[0]);
+            } else if (record.type == 'S') {
+                for (size_t i = 0; i < record.fields.size(); i += 4) {
+                    patched.insert(record.fields[i]);
+                }
+            }
+        }
+        for (auto const& name : backedUp) {
+            if (!utils::exists(name + ".orig")) {
+                continue;
+            }
+            copyFileToFrom(name, name + ".orig");
+            utils::remove(name + ".orig");
+        }
+        // A backup made without its 'F' record means the file was never
+        // patched
+        for (auto const& name : patched) {
+            if (!contains(backedUp, name)) {
+                utils::remove(name + ".orig");
+            }
+        }
+
+        if (replay) {
+            Replacer replacer;
+            for (auto const& record : records) {
+                if (record.type == 'S') {
+                    Step step;
+                    auto const& f = record.fields;
+                    for (size_t i = 0; i + 3 < f.size(); i += 4) {
+                        step.replacements.emplace_back(
+                            f[i], std::stoul(f[i + 1]), std::stoul(f[i + 2]),
+                            f[i + 3]);
+                    }
+                    replacer.applyStep(step);
+                    replacer.undoStack.push_back(std::move(step));
+                    replacer.redoStack.clear();
+                } else if (record.type == 'P') {
+                    replacer.restoreState(record);
+                } else if (record.type == 'U') {
+                    replacer.undo();
+                } else if (record.type == 'D') {
+                    replacer.redo();
+                }
+            }
+        }
+        journal.clear();
     }
 
     Replacer() = default;
@@ -57,49 +294,165 @@ public:
     Replacer& operator=(Replacer const&) = delete;
     Replacer& operator=(Replacer&&) = default;
 
-    void appendToLine(std::string const& fileName, int line,
+    // Create a replacement that appends text to the end of a line, where
+    // line is counted in the current contents of the file
+    Replacement appendReplacement(std::string const& fileName, int line,
+                                  std::string const& text)
+    {
+        PatchedFile unpatched{fileName};
+        auto it = patchedFiles.find(fileName);
+        auto& pf = it != patchedFiles.end() ? it->second : unpatched;
+
+        size_t offs = lineColToOffset(pf.contents(), line + 1, 1) - 1;
+        offs = pf.untranslateOffset(offs);
+        if (it != patchedFiles.end()) {
+            touchFile(fileName);
+        }
+        return {fileName, offs, 0, text};
+    }
+
+    // Current line and column of sorted original offsets in a file
+    std::vector<std::pair<int, int>>
+    lineColumns(std::string const& fileName,
+                std::vector<size_t> const& offsets)
+    {
+        auto it = patchedFiles.find(fileName);
+        if (it == patchedFiles.end()) {
+            return PatchedFile{fileName}.lineColumns(offsets);
+        }
+        auto result = it->second.lineColumns(offsets);
+        touchFile(fileName);
+        return result;
+    }
+
+    bool appendToLine(std::string const& fileName, int line,
                       std::string const& text)
     {
-        auto contents = patchedFiles.count(fileName) > 0
-                            ? readFile(fileName + ".orig")
-                            : readFile(fileName);
+        return applyReplacements({appendReplacement(fileName, line, text)});
+    }
 
-        size_t offs = lineColToOffset(contents, line + 1, 1) - 1;
-        applyReplacement({fileName, offs, 0, text});
+    // Number of changes made to a file, 0 if it has not been patched
+    size_t version(std::string const& name) const
+    {
+        auto it = patchedFiles.find(name);
+        return it != patchedFiles.end() ? it->second.version() : 0;
     }
 
-    // Patch the file, and remember the file and the replacement
-    // for subsequent patches
-    void applyReplacement(Replacement const& r)
+    // A copy of a file with its patch state, that can be patched without
+    // affecting the real file
+    PatchedFile snapshot(std::string const& name) const
     {
-        auto& pf = getPatchedFile(r.path);
-        pf.patch(r.offset, r.length, r.text);
-        pf.flush();
+        auto it = patchedFiles.find(name);
+        return it != patchedFiles.end() ? it->second : PatchedFile{name};
     }
 
-    // Copy a file, and also copy any replacement data if this file
-    // is already known by the replacer
-    void copyFile(std::string const& target, std::string const& source)
+    // Check if a replacement overlaps a replacement that has already been
+    // applied to the same file
+    bool conflicts(Replacement const& r) const
     {
-        auto it = patchedFiles.find(source);
-        // Patch data of source needs to be copied into target
-        if (it != patchedFiles.end()) {
-            patchedFiles[target] = it->second;
-            patchedFiles[target].setFileName(target);
-            copyFileToFrom(target + ".orig", source + ".orig");
+        auto it = patchedFiles.find(r.path);
+        return it != patchedFiles.end() &&
+               it->second.overlaps(r.offset, r.length);
+    }
+
+    // Apply a list of fixes as one step that can be undone. Each fix is a
+    // group of replacements that is applied entirely or not at all. Fixes
+    // that overlap an applied change or an earlier fix in the list are
+    // left out, and their indices are returned.
+    std::vector<size_t>
+    applyFixes(std::vector<std::vector<Replacement>> const& fixes)
+    {
+        std::vector<size_t> rejected;
+        std::map<std::string, IntervalIndex> batch;
+        Step step;
+
+        for (size_t i = 0; i < fixes.size(); i++) {
+            auto const& fix = fixes[i];
+            size_t accepted = 0;
+            for (auto const& r : fix) {
+                auto& index = batch[r.path];
+                if (conflicts(r) ||
+                    index.overlaps(r.offset, r.offset + r.length)) {
+                    break;
+                }
+                index.insert(r.offset, r.offset + r.length);
+                accepted++;
+            }
+            if (accepted < fix.size()) {
+                for (size_t j = 0; j < accepted; j++) {
+                    auto const& r = fix[j];
+                    batch[r.path].erase(r.offset, r.offset + r.length);
+                }
+                rejected.push_back(i);
+                continue;
+            }
+            step.replacements.insert(step.replacements.end(), fix.begin(),
+                                     fix.end());
         }
-        copyFileToFrom(target, source);
+
+        if (step.replacements.empty()) {
+            return rejected;
+        }
+        std::stable_sort(step.replacements.begin(), step.replacements.end(),
+                         [](Replacement const& a, Replacement const& b) {
+                             return std::tie(a.path, a.offset, a.length) <
+                                    std::tie(b.path, b.offset, b.length);
+                         });
+        writeStep(step);
+        applyStep(step);
+        undoStack.push_back(std::move(step));
+        redoStack.clear();
+        return rejected;
     }
 
-    void removeFile(std::string const& name)
+    // Apply a single fix as one step that can be undone. Returns false if
+    // it overlaps an applied change.
+    bool applyReplacements(std::vector<Replacement> const& replacements)
     {
-        auto it = patchedFiles.find(name);
-        if (it != patchedFiles.end()) {
-            patchedFiles.erase(it);
-            ::remove((name + ".orig").c_str());
+        return applyFixes({replacements}).empty();
+    }
+
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+
+    // Revert the last step. Since steps are undone in reverse order, each
+    // replacement is always the last patch of its file, so it can be
+    // reverted in place.
+    bool undo()
+    {
+        if (undoStack.empty()) {
+            return false;
         }
+        writeJournal('U');
+        auto step = std::move(undoStack.back());
+        undoStack.pop_back();
 
-        ::remove(name.c_str());
+        std::set<std::string> paths;
+        for (size_t i = step.replacements.size(); i-- > 0;) {
+            auto const& path = step.replacements[i].path;
+            patchedFiles[path].unpatch(step.removed[i]);
+            paths.insert(path);
+        }
+        for (auto const& path : paths) {
+            patchedFiles[path].flush();
+            touchFile(path);
+        }
+        redoStack.push_back(std::move(step));
+        return true;
+    }
+
+    // Apply the last undone step again
+    bool redo()
+    {
+        if (redoStack.empty()) {
+            return false;
+        }
+        writeJournal('D');
+        auto step = std::move(redoStack.back());
+        redoStack.pop_back();
+        applyStep(step);
+        undoStack.push_back(std::move(step));
+        return true;
     }
 };
 
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "glob.h"
+
+#include <fmt/format.h>
+#include <yaml-cpp/yaml.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Decisions to make without asking, for issues of some checks in some
+// files. The first rule that matches an issue decides.
+class Rules
+{
+public:
+    enum Action
+    {
+        None,
+        Apply,
+        Nolint,
+        NolintCheck,
+        Todo,
+        Skip,
+        ActionCount
+    };
+
+private:
+    struct Rule
+    {
+        Glob path;
+        Glob check;
+        Action action;
+    };
+    std::vector<Rule> rules_;
+
+    static std::array<char const*, ActionCount> const& actionNames()
+    {
+        static std::array<char const*, ActionCount> const names{
+            {"none", "apply", "nolint", "nolint-check", "todo", "skip"}};
+        return names;
+    }
+
+public:
+    // None if the name is not an action
+    static Action parseAction(std::string const& name)
+    {
+        for (size_t i = 0; i < ActionCount; i++) {
+            if (name == actionNames()[i]) {
+                return static_cast<Action>(i);
+            }
+        }
+        return None;
+    }
+
+    static char const* actionName(Action action)
+    {
+        return actionNames()[action];
+    }
+
+    bool empty() const { return rules_.empty(); }
+
+    void add(std::string const& path, std::string const& check,
+             Action action)
+    {
+        rules_.push_back({Glob{path}, Glob{check}, action});
+    }
+
+    // Add the rules of a rules file. What can not be used is left out,
+    // and the reason returned as a warning.
+    std::vector<std::string> read(std::string const& fileName)
+    {
+        std::vector<std::string> warnings;
+        YAML::Node config;
+        try {
+            config = YAML::LoadFile(fileName);
+        } catch (YAML::Exception& e) {
+            warnings.push_back(
+                fmt::format("Could not read {}: {}", fileName, e.what()));
+            return warnings;
+        }
+        if (config.IsNull()) {
+            return warnings;
+        }
+        auto list = config.IsMap() ? config["Rules"] : YAML::Node{};
+        if (!list.IsSequence()) {
+            warnings.push_back(fmt::format(
+                "Ignoring {}, it has no list of Rules", fileName));
+            return warnings;
+        }
+        for (auto const& rule : list) {
+            std::string path;
+            std::string check;
+            std::string actionName;
+            try {
+                path = rule["Path"] ? rule["Path"].as<std::string>() : "*";
+                check =
+                    rule["Check"] ? rule["Check"].as<std::string>() : "*";
+                actionName =
+                    rule["Action"] ? rule["Action"].as<std::string>() : "";
+            } catch (YAML::Exception& e) {
+                warnings.push_back(fmt::format("Skipping a rule in {}: {}",
+                                               fileName, e.what()));
+                continue;
+            }
+            auto action = parseAction(actionName);
+            if (action == None) {
+                warnings.push_back(fmt::format("Unknown action '{}' in {}",
+                                               actionName, fileName));
+                continue;
+            }
+            add(path, check, action);
+        }
+        return warnings;
+    }
+
+    Action match(std::string const& path, std::string const& check) const
+    {
+        for (auto const& rule : rules_) {
+            if (rule.check.match(check) && rule.path.match(path)) {
+                return rule.action;
+            }
+        }
+        return None;
+    }
+};
@@ -0,0 +1,37 @@
+#include "catch.hpp"
+#include "rules.h"
+#include "utils.h"
+
+#include <cstdio>
+
+TEST_CASE("rules", "")
+{
+    Rules rules;
+    rules.add("tests/*", "readability-magic-numbers", Rules::Nolint);
+    rules.add("*", "modernize-*", Rules::Apply);
+    REQUIRE(rules.match("tests/x.cpp", "readability-magic-numbers") ==
+            Rules::Nolint);
+    REQUIRE(rules.match("src/x.cpp", "readability-magic-numbers") ==
+            Rules::None);
+    REQUIRE(rules.match("src/x.cpp", "modernize-use-override") ==
+            Rules::Apply);
+    REQUIRE(Rules::parseAction("nolint-check") == Rules::NolintCheck);
+
+    // A file that is not a map of rules is ignored with a warning
+    writeFile("rulestest.yaml", "just a scalar\n");
+    Rules scalar;
+    REQUIRE(scalar.read("rulestest.yaml").size() == 1);
+    REQUIRE(scalar.empty());
+
+    writeFile("rulestest.yaml", "Rules:\n"
+                                "  - Check: 'modernize-*'\n"
+                                "    Action: apply\n"
+                                "  - Check: 'google-*'\n"
+                                "    Action: frobnicate\n");
+    Rules fromFile;
+    REQUIRE(fromFile.read("rulestest.yaml").size() == 1);
+    REQUIRE(fromFile.match("x.cpp", "modernize-use-override") ==
+            Rules::Apply);
+    REQUIRE(fromFile.match("x.cpp", "google-runtime-int") == Rules::None);
+    std::remove("rulestest.yaml");
+}
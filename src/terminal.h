@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <utility>
+
+// Keeps the terminal in raw mode (no line buffering, no echo) while it
+// exists, so keys can be read one at a time without switching modes for
+// every key. The original mode is restored when it goes out of scope, and
+// also if the program is killed by a signal.
+class RawTerminal
+{
+    bool owner = false;
+
+    static termios& savedMode()
+    {
+        static termios mode{};
+        return mode;
+    }
+
+    static bool& isActive()
+    {
+        static bool active = false;
+        return active;
+    }
+
+    static void restore()
+    {
+        if (isActive()) {
+            tcsetattr(0, TCSADRAIN, &savedMode());
+            isActive() = false;
+        }
+    }
+
+    static void onSignal(int sig)
+    {
+        restore();
+        std::signal(sig, SIG_DFL);
+        std::raise(sig);
+    }
+
+public:
+    RawTerminal()
+    {
+        if (isActive() || isatty(0) == 0) {
+            return;
+        }
+        if (tcgetattr(0, &savedMode()) < 0) {
+            throw std::runtime_error("tcgetattr()");
+        }
+        termios raw = savedMode();
+        raw.c_lflag &= ~ICANON;
+        raw.c_lflag &= ~ECHO;
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(0, TCSANOW, &raw) < 0) {
+            throw std::runtime_error("tcsetattr ICANON");
+        }
+        isActive() = true;
+        owner = true;
+        for (auto sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT}) {
+            std::signal(sig, &RawTerminal::onSignal);
+        }
+    }
+
+    ~RawTerminal()
+    {
+        if (!owner) {
+            return;
+        }
+        restore();
+        for (auto sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT}) {
+            std::signal(sig, SIG_DFL);
+        }
+    }
+
+    RawTerminal(RawTerminal const&) = delete;
+    RawTerminal& operator=(RawTerminal const&) = delete;
+
+    static bool active() { return isActive(); }
+};
+
+// Write all data to a file descriptor, with as few writes as possible
+inline void writeAll(int fd, char const* data, size_t size)
+{
+    while (size > 0) {
+        auto written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+// Rows and columns of the terminal, or a default size if not known
+inline std::pair<int, int> terminalSize()
+{
+    winsize ws{};
+    if (ioctl(1, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        return {ws.ws_row, ws.ws_col};
+    }
+    return {24, 80};
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "journal.h"
+#include "path.h"
+#include "tidy_results.h"
+#include "tool_probe.h"
+#include "utils.h"
+
+#include <fmt/format.h>
+#include <yaml-cpp/yaml.h>
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The log and fixes of the last clang-tidy run on a source file, together
+// with the checks that produced them. When only the checks have changed
+// since, the cached results can be reused: diagnostics of checks that were
+// removed are left out, and clang-tidy only has to run the added checks.
+//
+// The results are used as long as the files the run read are unchanged;
+// the source file, the headers it includes, every file that had
+// diagnostics and compile_commands.json. So must the other settings of
+// the run be; the header filter, the check options and the clang-tidy
+// binary.
+//
+// The cache files are named by a hash of the full path of the source file,
+// and the path is saved in them, so files that hash the same are told
+// apart.
+class TidyCache
+{
+    utils::path dir_;
+    utils::path source_;
+    std::string settings_;
+    utils::path meta_;
+    utils::path log_;
+    utils::path fixes_;
+    std::set<std::string> checks_;
+
+    // The include directories given with -I or -iquote in the compile
+    // command of a source file
+    static std::vector<std::string> includeDirs(utils::path const& database,
+                                                utils::path const& sourceFile)
+    {
+        std::vector<std::string> dirs;
+        YAML::Node commands;
+        try {
+            commands = YAML::LoadFile(database.string());
+        } catch (YAML::Exception&) {
+            return dirs;
+        }
+        if (!commands.IsSequence()) {
+            return dirs;
+        }
+        for (auto const& entry : commands) {
+            if (!entry.IsMap() || !entry["file"] || !entry["directory"]) {
+                continue;
+            }
+            utils::path dir = entry["directory"].as<std::string>();
+            if ((dir / entry["file"].as<std::string>()).string() !=
+                sourceFile.string()) {
+                continue;
+            }
+            std::vector<std::string> args;
+            if (entry["arguments"]) {
+                args = entry["arguments"].as<std::vector<std::string>>();
+            } else if (entry["command"]) {
+                std::istringstream in{entry["command"].as<std::string>()};
+                std::string arg;
+                while (in >> arg) {
+                    args.push_back(arg);
+                }
+            }
+            for (size_t i = 0; i < args.size(); i++) {
+                std::string inc;
+                if (args[i] == "-I" || args[i] == "-iquote") {
+                    inc = i + 1 < args.size() ? args[++i] : "";
+                } else if (args[i].compare(0, 2, "-I") == 0) {
+                    inc = args[i].substr(2);
+                }
+                if (!inc.empty()) {
+                    dirs.push_back((dir / inc).string());
+                }
+            }
+            break;
+        }
+        return dirs;
+    }
+
+    // Add the headers that a file includes, and the ones they include. A
+    // quoted name is looked for next to the including file first, then in
+    // the include directories. System headers are not found, and are
+    // left out.
+    static void addIncludes(utils::path const& fileName,
+                            std::vector<std::string> const& dirs,
+                            std::set<std::string>& files)
+    {
+        std::ifstream in{fileName.string()};
+        std::string line;
+        while (std::getline(in, line)) {
+            auto hash = line.find_first_not_of(" \t");
+            if (hash == std::string::npos || line[hash] != '#') {
+                continue;
+            }
+            auto directive = line.find_first_not_of(" \t", hash + 1);
+            if (directive == std::string::npos ||
+                line.compare(directive, 7, "include") != 0) {
+                continue;
+            }
+            auto open = line.find_first_of("\"<", directive + 7);
+            if (open == std::string::npos) {
+                continue;
+            }
+            auto close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+            if (close == std::string::npos) {
+                continue;
+            }
+            auto name = line.substr(open + 1, close - open - 1);
+            std::vector<std::string> candidates;
+            if (line[open] == '"') {
+                candidates.push_back(
+                    (fileName.parent_path() / name).string());
+            }
+            for (auto const& dir : dirs) {
+                candidates.push_back((utils::path{dir} / name).string());
+            }
+            for (auto const& candidate : candidates) {
+                if (utils::exists(candidate)) {
+                    if (files.insert(candidate).second) {
+                        addIncludes(candidate, dirs, files);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    // The files besides the source that clang-tidy reads when run on it.
+    // compile_commands.json is searched for in the directory of the source
+    // and its parents, so the places nearer to the source where it could
+    // appear are listed too.
+    static std::set<std::string> dependencies(utils::path const& sourceFile)
+    {
+        std::set<std::string> files;
+        auto source = sourceFile.is_absolute() ? sourceFile
+                                               : currentDir() / sourceFile;
+        std::vector<std::string> dirs;
+        auto dir = source.parent_path();
+        while (true) {
+            auto database = dir / "compile_commands.json";
+            files.insert(database.string());
+            if (utils::exists(database)) {
+                dirs = includeDirs(database, source);
+                break;
+            }
+            if (dir.empty()) {
+                break;
+            }
+            dir = dir.parent_path();
+        }
+        addIncludes(source, dirs, files);
+        return files;
+    }
+
+public:
+    // Settings are everything besides the checks that the results depend
+    // on, see settings()
+    TidyCache(utils::path const& dir, utils::path const& sourceFile,
+              std::string const& settings)
+        : dir_(dir), source_(sourceFile), settings_(settings)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (auto c : sourceFile.string()) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        auto key =
+            fmt::format("{}-{:016x}", sourceFile.filename().string(), hash);
+        meta_ = dir / (key + ".meta");
+        log_ = dir / (key + ".log");
+        fixes_ = dir / (key + ".yaml");
+    }
+
+    // Stamps of the .clang-tidy files that apply to a source file, which
+    // are looked for in its directory and all of its parents
+    static std::string configStamps(utils::path const& sourceFile)
+    {
+        auto source = sourceFile.is_absolute() ? sourceFile
+                                               : currentDir() / sourceFile;
+        std::string stamps;
+        auto dir = source.parent_path();
+        while (true) {
+            stamps += fileStamp(dir / ".clang-tidy") + ",";
+            if (dir.empty()) {
+                return stamps;
+            }
+            dir = dir.parent_path();
+        }
+    }
+
+    // The settings of running clang-tidy on a source file; the binary, the
+    // header filter, and the configuration except for the Checks, which
+    // the cache keeps track of by itself
+    static std::string settings(ToolProbe& clangTidy,
+                                utils::path const& sourceFile,
+                                std::string const& headerFilter)
+    {
+        std::istringstream in{
+            clangTidy.output("-dump-config " + sourceFile.string(),
+                             configStamps(sourceFile))};
+        std::string config;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 7, "Checks:") != 0) {
+                config += line + "\n";
+            }
+        }
+        return fmt::format("{} {}\n{}\n{}", clangTidy.tool().string(),
+                           clangTidy.stamp(), headerFilter, config);
+    }
+
+    // The checks that clang-tidy would run on a source file, with the
+    // given Checks option if it is not empty
+    static std::set<std::string> listChecks(ToolProbe& clangTidy,
+                                            utils::path const& sourceFile,
+                                            std::string const& option = "")
+    {
+        std::set<std::string> checks;
+        auto args = "-list-checks " + sourceFile.string();
+        if (!option.empty()) {
+            args += fmt::format(" -checks='{}'", option);
+        }
+        std::istringstream in{
+            clangTidy.output(args, configStamps(sourceFile))};
+        std::string line;
+        while (std::getline(in, line)) {
+            auto first = line.find_first_not_of(" \t");
+            if (first == std::string::npos || first == 0) {
+                continue;
+            }
+            checks.insert(line.substr(first, line.find_last_not_of(" \t\r") -
+                                                 first + 1));
+        }
+        return checks;
+    }
+
+    // Read the checks of the cached results. Returns false if there are
+    // none, or if they are out of date.
+    bool load()
+    {
+        checks_.clear();
+        bool valid = false;
+        for (auto const& record : Journal{meta_}.read()) {
+            auto const& f = record.fields;
+            if (record.type == 'P') {
+                valid = f.size() == 2 && f[0] == source_.string() &&
+                        f[1] == settings_;
+            } else if (record.type == 'F') {
+                if (f.size() != 2 || fileStamp(f[0]) != f[1]) {
+                    return false;
+                }
+            } else if (record.type == 'C') {
+                checks_.insert(f.begin(), f.end());
+            }
+        }
+        return valid && utils::exists(log_);
+    }
+
+    std::set<std::string> const& checks() const { return checks_; }
+
+    // Write the cached results to the log and fixes files, leaving out
+    // diagnostics of checks that are no longer used. If added checks were
+    // run, their results are read from the same files first and added at
+    // the end.
+    void merge(std::set<std::string> const& checks,
+               std::set<std::string> const& added, utils::path const& logFile,
+               utils::path const& fixesFile) const
+    {
+        auto results = TidyResults::read(log_, fixes_);
+        // Checks that were not listed, like compiler errors, are kept
+        results.filter([&](std::string const& check) {
+            return checks.count(check) > 0 || checks_.count(check) == 0;
+        });
+        if (!added.empty()) {
+            auto newResults = TidyResults::read(logFile, fixesFile);
+            newResults.filter([&](std::string const& check) {
+                return added.count(check) > 0;
+            });
+            results.append(newResults);
+        }
+        results.write(logFile, fixesFile);
+    }
+
+    // Save the results of a run with the given checks
+    void store(std::set<std::string> const& checks,
+               utils::path const& logFile, utils::path const& fixesFile)
+    {
+        auto results = TidyResults::read(logFile, fixesFile);
+        utils::create_directories(dir_);
+        results.write(log_, fixes_);
+
+        auto files = results.files();
+        files.insert(source_.string());
+        for (auto const& f : dependencies(source_)) {
+            files.insert(f);
+        }
+        utils::remove(meta_);
+        Journal meta{meta_};
+        meta.write('P', {source_.string(), settings_});
+        for (auto const& f : files) {
+            meta.write('F', {f, fileStamp(f)});
+        }
+        meta.write('C', {checks.begin(), checks.end()});
+        meta.sync();
+        checks_ = checks;
+    }
+};
@@ -0,0 +1,107 @@
+#include "catch.hpp"
+#include "path.h"
+#include "tidy_cache.h"
+#include "utils.h"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+TEST_CASE("tidy_cache", "")
+{
+    writeFile("cached.cpp", "int* a = NULL;\nint b = 0.5;\n");
+    writeFile("cached.log",
+              "cached.cpp:1:10: warning: use nullptr [modernize-use-nullptr]\n"
+              "int* a = NULL;\n"
+              "cached.cpp:2:9: warning: narrowing "
+              "[bugprone-narrowing,-warnings-as-errors]\n"
+              "cached.cpp:1:1: note: here\n");
+    writeFile("cached.yaml", "---\nMainSourceFile: cached.cpp\n"
+                             "Diagnostics:\n"
+                             "  - DiagnosticName: modernize-use-nullptr\n"
+                             "    Replacements: []\n"
+                             "  - DiagnosticName: bugprone-narrowing\n"
+                             "    Replacements: []\n"
+                             "...\n");
+
+    std::set<std::string> checks{"bugprone-narrowing",
+                                 "modernize-use-nullptr"};
+    TidyCache cache{"cachetest", "cached.cpp", "clang-tidy 1:2\n*\n"};
+    REQUIRE(!cache.load());
+    cache.store(checks, "cached.log", "cached.yaml");
+    REQUIRE(cache.load());
+    REQUIRE(cache.checks() == checks);
+
+    // A removed check is filtered out of both the log and the fixes
+    cache.merge({"modernize-use-nullptr"}, {}, "out.log", "out.yaml");
+    auto log = readFile("out.log");
+    REQUIRE(std::string(log.begin(), log.end()) ==
+            "cached.cpp:1:10: warning: use nullptr [modernize-use-nullptr]\n"
+            "int* a = NULL;\n");
+    auto fixes = readFile("out.yaml");
+    REQUIRE(std::string(fixes.begin(), fixes.end()) ==
+            "---\nMainSourceFile: cached.cpp\nDiagnostics:\n"
+            "  - DiagnosticName: modernize-use-nullptr\n"
+            "    Replacements: []\n...\n");
+
+    // Other settings, like new check options or another clang-tidy, do
+    // not match
+    REQUIRE(!TidyCache{"cachetest", "cached.cpp", "clang-tidy 1:3\n*\n"}
+                 .load());
+    // Neither do paths that differ only by '/' and '_'
+    TidyCache slashed{"cachetest", "sub/cached.cpp", "clang-tidy 1:2\n*\n"};
+    slashed.store(checks, "cached.log", "cached.yaml");
+    REQUIRE(!TidyCache{"cachetest", "sub_cached.cpp", "clang-tidy 1:2\n*\n"}
+                 .load());
+    REQUIRE(slashed.load());
+    REQUIRE(cache.load());
+
+    writeFile("cached.cpp", "int* a = nullptr;\n");
+    REQUIRE(!TidyCache{"cachetest", "cached.cpp", "clang-tidy 1:2\n*\n"}
+                 .load());
+
+    // Headers that the source includes, and the compile database, are
+    // part of the results too
+    utils::create_directories("cachedeps/inc");
+    writeFile("cachedeps/main.cpp", "#include \"local.h\"\n"
+                                    "#include <other.h>\n"
+                                    "#include <vector>\n");
+    writeFile("cachedeps/local.h", "int local;\n");
+    writeFile("cachedeps/inc/other.h", "  #  include \"nested.h\"\n");
+    writeFile("cachedeps/inc/nested.h", "int nested;\n");
+    writeFile("cachedeps/compile_commands.json",
+              fmt::format("[{{\"directory\": \"{}\", \"file\": "
+                          "\"main.cpp\", \"command\": \"c++ -Iinc -c "
+                          "main.cpp\"}}]\n",
+                          (currentDir() / "cachedeps").string()));
+    auto mainFile = (currentDir() / "cachedeps/main.cpp").string();
+    TidyCache deps{"cachetest", mainFile, "clang-tidy 1:2\n*\n"};
+    auto changed = [&](char const* fileName, char const* contents) {
+        deps.store(checks, "cached.log", "cached.yaml");
+        REQUIRE(deps.load());
+        writeFile(fileName, contents);
+        return !deps.load();
+    };
+    REQUIRE(changed("cachedeps/local.h", "long local;\n"));
+    REQUIRE(changed("cachedeps/inc/nested.h", "long nested;\n"));
+    REQUIRE(changed("cachedeps/compile_commands.json", "[]\n"));
+    // Once the include directory is gone from the compile command, its
+    // headers are not found
+    REQUIRE(!changed("cachedeps/inc/nested.h", "int nested;\n"));
+    for (auto const* f :
+         {"cachedeps/main.cpp", "cachedeps/local.h", "cachedeps/inc/other.h",
+          "cachedeps/inc/nested.h", "cachedeps/compile_commands.json",
+          "cachedeps/inc", "cachedeps"}) {
+        std::remove(f);
+    }
+
+    for (auto const& p : utils::directory_iterator{"cachetest"}) {
+        utils::remove(p.path());
+    }
+    for (auto const* f : {"cached.cpp", "cached.log", "cached.yaml", "out.log",
+                          "out.yaml", "cachetest"}) {
+        std::remove(f);
+    }
+}
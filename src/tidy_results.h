@@ -0,0 +1,171 @@
+#pragma once
+
+#include "path.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The log and exported fixes of a clang-tidy run, split into the text of
+// each diagnostic, so diagnostics can be picked by check and written out
+// again. The text is not parsed as YAML, so it is written back exactly as
+// clang-tidy wrote it.
+//
+// Diagnostics are assumed to come in the same order in the log and in the
+// fixes, like autotidy expects when reading them.
+class TidyResults
+{
+    // Diagnostics of a log or fixes file, with the text before them
+    struct Parts
+    {
+        std::string head;
+        std::vector<std::pair<std::string, std::string>> items;
+    };
+
+    Parts log_;
+    Parts fixes_;
+
+    static std::string readText(utils::path const& fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    // Split a log into the text of each diagnostic, starting with its
+    // warning line and followed by its notes
+    static Parts splitLog(std::string const& text)
+    {
+        Parts parts;
+        std::string* current = &parts.head;
+        std::istringstream in{text};
+        std::string line;
+        std::smatch m;
+        while (std::getline(in, line)) {
+            if (std::regex_match(line, m, diagnosticLine()) &&
+                m[5] != "note") {
+                auto check = m[7].str();
+                parts.items.emplace_back(check.substr(0, check.find(',')),
+                                         "");
+                current = &parts.items.back().second;
+            }
+            *current += line + "\n";
+        }
+        return parts;
+    }
+
+    // Split fixes into the entries of the Diagnostics list
+    static Parts splitFixes(std::string const& text)
+    {
+        static std::string const entry = "  - DiagnosticName:";
+        Parts parts;
+        std::string* current = &parts.head;
+        std::istringstream in{text};
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, entry.size(), entry) == 0) {
+                auto check = line.substr(entry.size());
+                auto first = check.find_first_not_of(" '");
+                auto last = check.find_last_not_of(" '");
+                parts.items.emplace_back(
+                    first == std::string::npos
+                        ? ""
+                        : check.substr(first, last - first + 1),
+                    "");
+                current = &parts.items.back().second;
+            } else if (line == "...") {
+                break;
+            } else if (line.compare(0, 12, "Diagnostics:") == 0 &&
+                       current == &parts.head) {
+                continue;
+            }
+            *current += line + "\n";
+        }
+        return parts;
+    }
+
+    template <typename Keep>
+    static void filterParts(Parts& parts, Keep keep)
+    {
+        auto end = std::remove_if(
+            parts.items.begin(), parts.items.end(),
+            [&](auto const& item) { return !keep(item.first); });
+        parts.items.erase(end, parts.items.end());
+    }
+
+public:
+    static std::regex const& diagnosticLine()
+    {
+        static std::regex const re{
+            R"((([^:]+):(\d+):(\d+):)?\s*(\w+):\s*(.*)\[(.*)\])"};
+        return re;
+    }
+
+    // Missing files are read as no diagnostics
+    static TidyResults read(utils::path const& logFile,
+                            utils::path const& fixesFile)
+    {
+        TidyResults results;
+        results.log_ = splitLog(readText(logFile));
+        results.fixes_ = splitFixes(readText(fixesFile));
+        return results;
+    }
+
+    size_t size() const { return log_.items.size(); }
+
+    // The files that have diagnostics
+    std::set<std::string> files() const
+    {
+        std::set<std::string> result;
+        std::smatch m;
+        for (auto const& item : log_.items) {
+            auto line = item.second.substr(0, item.second.find('\n'));
+            if (std::regex_match(line, m, diagnosticLine()) &&
+                m[2].matched) {
+                result.insert(m[2]);
+            }
+        }
+        return result;
+    }
+
+    // Keep the diagnostics whose check passes the test
+    template <typename Keep>
+    void filter(Keep keep)
+    {
+        filterParts(log_, keep);
+        filterParts(fixes_, keep);
+    }
+
+    // Add the diagnostics of other results at the end
+    void append(TidyResults const& other)
+    {
+        log_.items.insert(log_.items.end(), other.log_.items.begin(),
+                          other.log_.items.end());
+        fixes_.items.insert(fixes_.items.end(), other.fixes_.items.begin(),
+                            other.fixes_.items.end());
+    }
+
+    void write(utils::path const& logFile, utils::path const& fixesFile) const
+    {
+        auto log = log_.head;
+        for (auto const& item : log_.items) {
+            log += item.second;
+        }
+        writeFile(logFile, log);
+
+        std::string fixes = fixes_.head.empty() ? "---\n" : fixes_.head;
+        fixes += fixes_.items.empty() ? "Diagnostics: []\n"
+                                      : "Diagnostics:\n";
+        for (auto const& item : fixes_.items) {
+            fixes += item.second;
+        }
+        writeFile(fixesFile, fixes + "...\n");
+    }
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "path.h"
+#include "utils.h"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// Output of running a tool with some arguments, like `clang-tidy
+// --version`, that only changes when the tool does. The outputs are saved
+// in a cache file together with the path, modification time and size of
+// the tool, and used for as long as those are the same. Outputs that also
+// depend on other files, like the configs that `-list-checks` reads, are
+// saved with the stamps of those files as their inputs. Runs that fail are
+// not saved.
+//
+// The cache file has the path and the stamp of the tool on the first two
+// lines, then for each output the arguments, the inputs and the size of
+// the output on a line each, followed by the output.
+class ToolProbe
+{
+    struct Output
+    {
+        std::string inputs;
+        std::string text;
+    };
+
+    utils::path cacheFile_;
+    utils::path tool_;
+    std::string stamp_;
+    // Outputs may be asked for from more than one thread
+    std::mutex lock_;
+    std::map<std::string, Output> outputs_;
+
+    // Write the cache under a temporary name first, so it is never seen
+    // half written
+    void save() const
+    {
+        auto text = fmt::format("{}\n{}\n", tool_.string(), stamp_);
+        for (auto const& o : outputs_) {
+            text += fmt::format("{}\n{}\n{}\n{}", o.first, o.second.inputs,
+                                o.second.text.size(), o.second.text);
+        }
+        utils::create_directories(cacheFile_.parent_path());
+        auto temp = cacheFile_.string() + ".tmp";
+        writeFile(temp, text);
+        std::rename(temp.c_str(), cacheFile_.string().c_str());
+    }
+
+public:
+    ToolProbe(utils::path const& cacheFile, utils::path const& tool)
+        : cacheFile_(cacheFile), tool_(tool), stamp_(fileStamp(tool))
+    {
+        std::ifstream in{cacheFile_.string(), std::ios::binary};
+        std::string cachedTool;
+        std::string cachedStamp;
+        if (!std::getline(in, cachedTool) || !std::getline(in, cachedStamp) ||
+            cachedTool != tool_.string() || cachedStamp != stamp_ ||
+            stamp_.empty()) {
+            return;
+        }
+        std::string args;
+        std::string inputs;
+        size_t size = 0;
+        while (std::getline(in, args) && std::getline(in, inputs) &&
+               in >> size && in.get() == '\n') {
+            std::string text(size, 0);
+            if (!in.read(&text[0], static_cast<std::streamsize>(size))) {
+                break;
+            }
+            outputs_[args] = {inputs, std::move(text)};
+        }
+    }
+
+    utils::path const& tool() const { return tool_; }
+
+    // Modification time and size of the tool
+    std::string const& stamp() const { return stamp_; }
+
+    // The output of the tool run with the arguments. Inputs are the stamps
+    // of the other files the output depends on, and a saved output is only
+    // used if they are the same. A new output replaces the one saved for
+    // the same arguments.
+    std::string output(std::string const& args, std::string const& inputs = "")
+    {
+        {
+            std::lock_guard<std::mutex> guard{lock_};
+            auto it = outputs_.find(args);
+            if (it != outputs_.end() && it->second.inputs == inputs) {
+                return it->second.text;
+            }
+        }
+        int status = 0;
+        auto text = pipeCommandToString(
+            fmt::format("{} {}", tool_.string(), args), status);
+        if (status == 0 && (args + inputs).find('\n') == std::string::npos) {
+            std::lock_guard<std::mutex> guard{lock_};
+            outputs_[args] = {inputs, text};
+            save();
+        }
+        return text;
+    }
+};
@@ -0,0 +1,65 @@
+#include "catch.hpp"
+#include "path.h"
+#include "tool_probe.h"
+#include "utils.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+TEST_CASE("tool_probe", "")
+{
+    // A fake tool that logs every run, and fails when asked to
+    char dir[] = "/tmp/probetestXXXXXX";
+    REQUIRE(mkdtemp(dir) != nullptr);
+    auto tool = std::string(dir) + "/tool";
+    auto runs = std::string(dir) + "/runs";
+    auto cache = std::string(dir) + "/probes";
+    auto writeTool = [&](std::string const& version) {
+        writeFile(tool, fmt::format("#!/bin/sh\n"
+                                    "echo run >> {}\n"
+                                    "[ \"$1\" = fail ] && echo broken && "
+                                    "exit 1\n"
+                                    "echo {}\n",
+                                    runs, version));
+        chmod(tool.c_str(), 0755);
+    };
+    auto runCount = [&] {
+        auto data = utils::exists(runs) ? readFile(runs) : std::vector<char>{};
+        return std::count(data.begin(), data.end(), '\n');
+    };
+    writeTool("1.0");
+
+    REQUIRE(ToolProbe{cache, tool}.output("--version") == "1.0\n");
+    REQUIRE(ToolProbe{cache, tool}.output("--version") == "1.0\n");
+    REQUIRE(runCount() == 1);
+
+    // Failed runs are not cached
+    REQUIRE(ToolProbe{cache, tool}.output("fail") == "broken\n");
+    REQUIRE(ToolProbe{cache, tool}.output("fail") == "broken\n");
+    REQUIRE(runCount() == 3);
+
+    // A changed tool starts over
+    writeTool("10.0");
+    REQUIRE(ToolProbe{cache, tool}.output("--version") == "10.0\n");
+    REQUIRE(runCount() == 4);
+
+    // Outputs that depend on other files are only reused while their
+    // stamps are the same, and the newest one replaces the saved one
+    REQUIRE(ToolProbe{cache, tool}.output("-list-checks", "1:2") == "10.0\n");
+    REQUIRE(ToolProbe{cache, tool}.output("-list-checks", "1:2") == "10.0\n");
+    REQUIRE(runCount() == 5);
+    REQUIRE(ToolProbe{cache, tool}.output("-list-checks", "1:3") == "10.0\n");
+    REQUIRE(ToolProbe{cache, tool}.output("-list-checks", "1:3") == "10.0\n");
+    REQUIRE(ToolProbe{cache, tool}.output("--version") == "10.0\n");
+    REQUIRE(runCount() == 6);
+
+    for (auto const& f : {tool, runs, cache, std::string(dir)}) {
+        std::remove(f.c_str());
+    }
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "path.h"
+#include "terminal.h"
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -36,6 +38,32 @@ inline void pipeCommandToFile(std::string const& cmdLine,
     pclose(fp);
 }
 
+// The output of a command. Status is set to what pclose() returns, which
+// is 0 only if the command exited successfully.
+inline std::string pipeCommandToString(std::string const& cmdLine,
+                                       int& status)
+{
+    std::string result;
+    std::array<char, 4096> buf{};
+    auto* fp = popen(cmdLine.c_str(), "r");
+    if (fp == nullptr) {
+        status = -1;
+        return result;
+    }
+    size_t sz = 0;
+    while ((sz = fread(buf.data(), 1, buf.size(), fp)) > 0) {
+        result.append(buf.data(), sz);
+    }
+    status = pclose(fp);
+    return result;
+}
+
+inline std::string pipeCommandToString(std::string const& cmdLine)
+{
+    int status = 0;
+    return pipeCommandToString(cmdLine, status);
+}
+
 inline void pipeStringToCommand(std::string const& cmdLine,
                                 std::string const& text)
 {
@@ -47,6 +75,13 @@ inline void pipeStringToCommand(std::string const& cmdLine,
 inline char getch()
 {
     char buf = 0;
+    // In raw mode we can just read the key
+    if (RawTerminal::active()) {
+        if (read(0, &buf, 1) < 0) {
+            throw std::runtime_error("read()");
+        }
+        return buf;
+    }
     termios old{};
     if (tcgetattr(0, &old) < 0) {
         throw std::runtime_error("tcsetattr()");
@@ -76,6 +111,30 @@ inline utils::path currentDir()
     return utils::path(std::string(&buf[0]));
 }
 
+// Modification time of a file in nanoseconds, where the file system has
+// them
+inline int64_t modificationTime(struct stat const& sb)
+{
+#ifdef __APPLE__
+    auto const& t = sb.st_mtimespec;
+#else
+    auto const& t = sb.st_mtim;
+#endif
+    return static_cast<int64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+// Modification time and size of a file, to tell if it changed. Empty if
+// the file does not exist.
+inline std::string fileStamp(utils::path const& fileName)
+{
+    struct stat sb; // NOLINT
+    if (stat(fileName.string().c_str(), &sb) < 0) {
+        return "";
+    }
+    return std::to_string(modificationTime(sb)) + ":" +
+           std::to_string(sb.st_size);
+}
+
 inline void copyFileToFrom(utils::path const& target, utils::path const& source)
 {
     utils::remove(target);